@@ -20,6 +20,9 @@
 
 #include <cppbugs/mcmc.deterministic.hpp>
 #include <cppbugs/mcmc.model.hpp>
+#include <cppbugs/mcmc.multichain.hpp>
+#include <cppbugs/mcmc.tempering.hpp>
+#include <cppbugs/mcmc.static.model.hpp>
 #include <cppbugs/distributions/mcmc.normal.hpp>
 #include <cppbugs/distributions/mcmc.multivariate.normal.hpp>
 #include <cppbugs/distributions/mcmc.uniform.hpp>
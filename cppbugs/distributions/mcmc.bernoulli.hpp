@@ -22,40 +22,134 @@
 #include <cmath>
 #include <armadillo>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.conjugate.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U>
-  class BernoulliLikelihiood : public Likelihiood {
+  template <typename T,typename U, typename M = ExactMath>
+  class BernoulliLikelihiood : public Likelihiood, public BinomialConjugate {
     const T& x_;
     const U p_;
   public:
-    BernoulliLikelihiood(const T& x, const U& p) : x_(x), p_(p) { dimension_check(x_, p_); }
+    BernoulliLikelihiood(const T& x, const U& p) : x_(x), p_(p) { dimension_check(x_, p_);
+      argument<T>(x_); argument<U>(p_);
+    }
     inline double calc() const {
-      return bernoulli_logp(x_,p_);
+      return bernoulli_logp<M>(x_,p_);
+    }
+    // log-pmfs are below 0, up to the error of log_approx
+    double upper_bound() const { return dim_size(x_) * log_approx_error_above; }
+    size_t elements() const { return chunkable(x_) && chunkable(p_) ? dim_size(x_) : 0; }
+    double calc_chunk(const size_t first, const size_t last) const {
+      return bernoulli_logp<M>(chunk(x_,first,last),chunk(p_,first,last));
+    }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&p_, dim_size(p_), to_double(x_)/p_ - to_double(1 - x_)/(1.0 - p_));
+      return true;
+    }
+    const void* x_address() const { return &x_; }
+    const void* n_address() const { return nullptr; }
+    const void* p_address() const { return &p_; }
+    double successes() const { return arma::accu(x_); }
+    double failures() const { return dim_size(x_) - arma::accu(x_); }
+  };
+
+  // x is data and p a scalar: calc() only needs the number of ones
+  template <typename T,typename U, typename M = ExactMath>
+  class BernoulliSufficientLikelihiood : public Likelihiood, public BinomialConjugate {
+    const T& x_;
+    const U p_;
+    double n_, ones_;
+    bool valid_;
+  public:
+    BernoulliSufficientLikelihiood(const T& x, const U& p): x_(x), p_(p), n_(dim_size(x)), ones_(0), valid_(true) {
+      argument<U>(p_);
+      for(size_t i = 0; i < x.n_elem; i++) {
+        ones_ += x[i];
+        valid_ = valid_ && x[i] >= 0 && x[i] <= 1;
+      }
+    }
+    inline double calc() const {
+      if(!valid_)
+        return -std::numeric_limits<double>::infinity();
+      return ones_ * M::log(p_) + (n_ - ones_) * M::log(1 - p_);
+    }
+    double upper_bound() const { return n_ * log_approx_error_above; }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&p_, 1, ones_/p_ - (n_ - ones_)/(1.0 - p_));
+      return true;
     }
+    const void* x_address() const { return &x_; }
+    const void* n_address() const { return nullptr; }
+    const void* p_address() const { return &p_; }
+    double successes() const { return ones_; }
+    double failures() const { return n_ - ones_; }
   };
 
-  template<typename T>
+  template<typename T, typename U, typename M>
+  Likelihiood* observed_bernoulli(const T& x, const U& p, std::false_type) {
+    return new BernoulliLikelihiood<T,U,M>(x, p);
+  }
+
+  template<typename T, typename U, typename M>
+  Likelihiood* observed_bernoulli(const T& x, const U& p, std::true_type) {
+    return new BernoulliSufficientLikelihiood<T,U,M>(x, p);
+  }
+
+  template<typename T, typename M = ExactMath>
   class Bernoulli : public DynamicStochastic<T> {
 
-    template<typename U>
-    void bernoulli_jump(RngBase& rng, U& value, const double scale) {
+    template<typename R, typename U>
+    void bernoulli_jump(R& rng, U& value, const double scale) {
       double jump_probability = 1.0 - pow(0.5,scale);
-      for(unsigned int i = 0; i < value.n_elem; i++) {
-        if(rng.uniform() < jump_probability)
-          value[ i ] = !value[ i ];
+      double u[jump_block_size];
+      for(size_t first = 0; first < value.n_elem; first += jump_block_size) {
+        const size_t n = std::min<size_t>(jump_block_size, value.n_elem - first);
+        rng.uniform(u, n);
+        for(size_t i = 0; i < n; i++) {
+          if(u[i] < jump_probability)
+            value[ first + i ] = !value[ first + i ];
+        }
       }
     }
 
-    void bernoulli_jump(RngBase& rng, int& value, const double scale) {
+    // value = old_value with some elements flipped, in one pass
+    template<typename R, typename U>
+    void bernoulli_jump(R& rng, U& value, const U& old_value, const double scale) {
+      double jump_probability = 1.0 - pow(0.5,scale);
+      double u[jump_block_size];
+      for(size_t first = 0; first < value.n_elem; first += jump_block_size) {
+        const size_t n = std::min<size_t>(jump_block_size, value.n_elem - first);
+        rng.uniform(u, n);
+        for(size_t i = 0; i < n; i++) {
+          value[ first + i ] = u[i] < jump_probability ? !old_value[ first + i ] : old_value[ first + i ];
+        }
+      }
+    }
+
+    template<typename R>
+    void bernoulli_jump(R& rng, int& value, const int old_value, const double scale) {
+      value = old_value;
+      bernoulli_jump(rng, value, scale);
+    }
+
+    template<typename R>
+    void bernoulli_jump(R& rng, double& value, const double old_value, const double scale) {
+      value = old_value;
+      bernoulli_jump(rng, value, scale);
+    }
+
+    template<typename R>
+    void bernoulli_jump(R& rng, int& value, const double scale) {
       double jump_probability = 1.0 - pow(0.5,scale);
       if(rng.uniform() < jump_probability) {
         value = !value;
       }
     }
 
-    void bernoulli_jump(RngBase& rng, double& value, const double scale) {
+    template<typename R>
+    void bernoulli_jump(R& rng, double& value, const double scale) {
       double jump_probability = 1.0 - pow(0.5,scale);
       if(rng.uniform() < jump_probability) {
         value = !value;
@@ -65,27 +159,41 @@ namespace cppbugs {
   public:
     Bernoulli(T value): DynamicStochastic<T>(value) {}
 
-    void jump(RngBase& rng) {
-      bernoulli_jump(rng, DynamicStochastic<T>::value, DynamicStochastic<T>::scale_);
+    template<typename R>
+    void jump_with(R& rng) {
+      // after preserve() a double buffered value holds a stale draw
+      if(DynamicStochastic<T>::buffered()) {
+        bernoulli_jump(rng, DynamicStochastic<T>::value, DynamicStochastic<T>::old_value, DynamicStochastic<T>::scale_);
+      } else {
+        bernoulli_jump(rng, DynamicStochastic<T>::value, DynamicStochastic<T>::scale_);
+      }
     }
+    void jump(RngBase& rng) { jump_with(rng); }
 
     template<typename U>
-    Bernoulli<T>& dbern(/*const*/ U&& p) {
-      Stochastic::likelihood_functor = new BernoulliLikelihiood<T,U>(DynamicStochastic<T>::value,p);
+    Bernoulli<T, M>& dbern(/*const*/ U&& p) {
+      Stochastic::likelihood_functor = new BernoulliLikelihiood<T,U,M>(DynamicStochastic<T>::value,p);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedBernoulli : public Observed<T> {
   public:
     ObservedBernoulli(const T& value): Observed<T>(value) {}
 
     template<typename U>
-    ObservedBernoulli<T>& dbern(/*const*/ U&& p) {
-      Stochastic::likelihood_functor = new BernoulliLikelihiood<T,U>(Observed<T>::value,p);
+    ObservedBernoulli<T, M>& dbern(/*const*/ U&& p) {
+      Stochastic::likelihood_functor = observed_bernoulli<T,U,M>(Observed<T>::value, p,
+        std::integral_constant<bool, !is_scalar_arg<T>::value && is_scalar_arg<U>::value>());
       return *this;
     }
   };
+
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U>
+  BernoulliLikelihiood<T,U,M> dbern(const T& x, /*const*/ U&& p) {
+    return BernoulliLikelihiood<T,U,M>(x, p);
+  }
 } // namespace cppbugs
 #endif // MCMC_BERNOULLI_HPP
@@ -21,44 +21,64 @@
 #include <armadillo>
 #include <cppbugs/mcmc.dynamic.stochastic.hpp>
 #include <cppbugs/mcmc.observed.hpp>
+#include <cppbugs/mcmc.conjugate.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
-  class BetaLikelihiood : public Likelihiood {
+  template <typename T,typename U, typename V, typename M = ExactMath>
+  class BetaLikelihiood : public Likelihiood, public BetaConjugate {
     const T& x_;
     const U alpha_;
     const V beta_;
   public:
-    BetaLikelihiood(const T& x, const U& alpha, const V& beta): x_(x), alpha_(alpha), beta_(beta) { dimension_check(x_, alpha_, beta_); }
+    BetaLikelihiood(const T& x, const U& alpha, const V& beta): x_(x), alpha_(alpha), beta_(beta) { dimension_check(x_, alpha_, beta_);
+      argument<T>(x_); argument<U>(alpha_); argument<V>(beta_);
+    }
     inline double calc() const {
-      return beta_logp(x_,alpha_,beta_);
+      return beta_logp<M>(x_,alpha_,beta_);
+    }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&x_, dim_size(x_), (alpha_ - 1.0)/x_ - (beta_ - 1.0)/(1.0 - x_));
+      adj.add(&alpha_, dim_size(alpha_), digamma(alpha_ + beta_) - digamma(alpha_) + M::log(x_));
+      adj.add(&beta_, dim_size(beta_), digamma(alpha_ + beta_) - digamma(beta_) + M::log(1.0 - x_));
+      return true;
     }
+    const void* x_address() const { return &x_; }
+    const void* alpha_address() const { return &alpha_; }
+    const void* beta_address() const { return &beta_; }
+    double alpha() const { return scalar_value(alpha_); }
+    double beta() const { return scalar_value(beta_); }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class Beta : public DynamicStochastic<T> {
   public:
     Beta(T value): DynamicStochastic<T>(value) {}
 
     template<typename U, typename V>
-    Beta<T>& dbeta(/*const*/ U&& alpha, /*const*/ V&& beta) {
-      Stochastic::likelihood_functor = new BetaLikelihiood<T,U,V>(DynamicStochastic<T>::value,alpha,beta);
+    Beta<T, M>& dbeta(/*const*/ U&& alpha, /*const*/ V&& beta) {
+      Stochastic::likelihood_functor = new BetaLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,alpha,beta);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedBeta : public Observed<T> {
   public:
     ObservedBeta(const T& value): Observed<T>(value) {}
 
     template<typename U, typename V>
-    ObservedBeta<T>& dbeta(/*const*/ U&& alpha, /*const*/ V&& beta) {
-      Stochastic::likelihood_functor = new BetaLikelihiood<T,U,V>(Observed<T>::value,alpha,beta);
+    ObservedBeta<T, M>& dbeta(/*const*/ U&& alpha, /*const*/ V&& beta) {
+      Stochastic::likelihood_functor = new BetaLikelihiood<T,U,V,M>(Observed<T>::value,alpha,beta);
       return *this;
     }
   };
 
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  BetaLikelihiood<T,U,V,M> dbeta(const T& x, /*const*/ U&& alpha, /*const*/ V&& beta) {
+    return BetaLikelihiood<T,U,V,M>(x, alpha, beta);
+  }
 } // namespace cppbugs
 #endif // MCMC_BETA_HPP
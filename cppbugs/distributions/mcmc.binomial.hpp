@@ -21,44 +21,117 @@
 #include <armadillo>
 #include <cppbugs/mcmc.dynamic.stochastic.hpp>
 #include <cppbugs/mcmc.observed.hpp>
+#include <cppbugs/mcmc.conjugate.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
-  class BinomialLikelihiood : public Likelihiood {
+  template <typename T,typename U, typename V, typename M = ExactMath>
+  class BinomialLikelihiood : public Likelihiood, public BinomialConjugate {
     const T& x_;
     const U n_;
     const V p_;
   public:
-    BinomialLikelihiood(const T& x,  const U& n,  const V& p): x_(x), n_(n), p_(p) { dimension_check(x_, n_, p_); }
+    BinomialLikelihiood(const T& x,  const U& n,  const V& p): x_(x), n_(n), p_(p) { dimension_check(x_, n_, p_);
+      argument<T>(x_); argument<U>(n_); argument<V>(p_);
+    }
     inline double calc() const {
-      return binom_logp(x_,n_,p_);
+      return binom_logp<M>(x_,n_,p_);
+    }
+    // log-pmfs are below 0, up to the error of log_approx, n is taken as data
+    double upper_bound() const { return broadcast_sum(n_, x_) * log_approx_error_above; }
+    size_t elements() const { return chunkable(x_) && chunkable(n_) && chunkable(p_) ? dim_size(x_) : 0; }
+    double calc_chunk(const size_t first, const size_t last) const {
+      return binom_logp<M>(chunk(x_,first,last),chunk(n_,first,last),chunk(p_,first,last));
     }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&p_, dim_size(p_), to_double(x_)/p_ - to_double(n_ - x_)/(1.0 - p_));
+      return true;
+    }
+    const void* x_address() const { return &x_; }
+    const void* n_address() const { return &n_; }
+    const void* p_address() const { return &p_; }
+    double successes() const { return arma::accu(x_); }
+    double failures() const { return arma::accu(n_ - x_); }
   };
 
-  template<typename T>
+  // x and n are data and p a scalar: calc() only needs the totals of x and n,
+  // the factln terms are a constant
+  template <typename T,typename U, typename V, typename M = ExactMath>
+  class BinomialSufficientLikelihiood : public Likelihiood, public BinomialConjugate {
+    const T& x_;
+    const U n_;
+    const V p_;
+    double x_sum_, n_sum_, constant_;
+    bool valid_;
+  public:
+    BinomialSufficientLikelihiood(const T& x, const U& n, const V& p): x_(x), n_(n), p_(p),
+      x_sum_(0), n_sum_(0), constant_(0), valid_(true) { dimension_check(x_, n_, p_);
+      argument<V>(p_);
+      for(size_t i = 0; i < x.n_elem; i++) {
+        const double x_i = x[i], n_i = broadcast_at(n, i);
+        x_sum_ += x_i;
+        n_sum_ += n_i;
+        constant_ += arma::factln(static_cast<int>(n_i)) - arma::factln(static_cast<int>(x_i)) - arma::factln(static_cast<int>(n_i - x_i));
+        valid_ = valid_ && x_i >= 0 && x_i <= n_i;
+      }
+    }
+    inline double calc() const {
+      if(!valid_)
+        return -std::numeric_limits<double>::infinity();
+      return x_sum_ * M::log(p_) + (n_sum_ - x_sum_) * M::log(1 - p_) + constant_;
+    }
+    double upper_bound() const { return n_sum_ * log_approx_error_above; }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&p_, 1, x_sum_/p_ - (n_sum_ - x_sum_)/(1.0 - p_));
+      return true;
+    }
+    const void* x_address() const { return &x_; }
+    const void* n_address() const { return &n_; }
+    const void* p_address() const { return &p_; }
+    double successes() const { return x_sum_; }
+    double failures() const { return n_sum_ - x_sum_; }
+  };
+
+  template<typename T, typename U, typename V, typename M>
+  Likelihiood* observed_binomial(const T& x, const U& n, const V& p, std::false_type) {
+    return new BinomialLikelihiood<T,U,V,M>(x, n, p);
+  }
+
+  template<typename T, typename U, typename V, typename M>
+  Likelihiood* observed_binomial(const T& x, const U& n, const V& p, std::true_type) {
+    return new BinomialSufficientLikelihiood<T,U,V,M>(x, n, p);
+  }
+
+  template<typename T, typename M = ExactMath>
   class Binomial : public DynamicStochastic<T> {
   public:
     Binomial(T value): DynamicStochastic<T>(value) {}
 
     template<typename U, typename V>
-    Binomial<T>& dbinom(/*const*/ U&& n, /*const*/ V&& p) {
-      Stochastic::likelihood_functor = new BinomialLikelihiood<T,U,V>(DynamicStochastic<T>::value,n,p);
+    Binomial<T, M>& dbinom(/*const*/ U&& n, /*const*/ V&& p) {
+      Stochastic::likelihood_functor = new BinomialLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,n,p);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedBinomial : public Observed<T> {
   public:
     ObservedBinomial(const T& value): Observed<T>(value) {}
 
     template<typename U, typename V>
-    ObservedBinomial<T>& dbinom(/*const*/ U&& n, /*const*/ V&& p) {
-      Stochastic::likelihood_functor = new BinomialLikelihiood<T,U,V>(Observed<T>::value, n, p);
+    ObservedBinomial<T, M>& dbinom(/*const*/ U&& n, /*const*/ V&& p) {
+      Stochastic::likelihood_functor = observed_binomial<T,U,V,M>(Observed<T>::value, n, p,
+        std::integral_constant<bool, !is_scalar_arg<T>::value && is_constant_arg<U>::value && is_scalar_arg<V>::value>());
       return *this;
     }
   };
 
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  BinomialLikelihiood<T,U,V,M> dbinom(const T& x, /*const*/ U&& n, /*const*/ V&& p) {
+    return BinomialLikelihiood<T,U,V,M>(x, n, p);
+  }
 } // namespace cppbugs
 #endif // MCMC_BINOMIAL_HPP
@@ -20,65 +20,112 @@
 
 
 #include <cmath>
+#include <map>
+#include <vector>
+#include <utility>
 #include <armadillo>
 #include <cppbugs/mcmc.stochastic.hpp>
 
 namespace cppbugs {
 
-  template<typename T, typename U, typename Enable = void>
+  template<typename T, typename U, typename M = ExactMath, typename Enable = void>
   class DiscreteLikelihiood;
 
-  template<typename T, typename U>
-  class DiscreteLikelihiood<T, U, typename std::enable_if<std::is_integral<typename std::remove_reference<T>::type>::value>::type> : public Likelihiood {
+  template<typename T, typename U, typename M>
+  class DiscreteLikelihiood<T, U, M, typename std::enable_if<std::is_integral<typename std::remove_reference<T>::type>::value>::type> : public Likelihiood {
     const T& x_;
     const U p_;
   public:
-    DiscreteLikelihiood(const T& x, const U& p): x_(x), p_(p) { }
+    DiscreteLikelihiood(const T& x, const U& p): x_(x), p_(p) { argument<T>(x_); argument<U>(p_); }
     inline double calc() const {
       if(x_ < 0 || x_ >= (int)p_.n_elem)
         return -std::numeric_limits<double>::infinity();
-      return log_approx(p_[x_]) - log_approx(arma::accu(p_));
+      return M::log(p_[x_]) - M::log(arma::accu(p_));
     }
+    // log-pmfs are below 0, up to the error of log_approx
+    double upper_bound() const { return log_approx_error_above - log_approx_error_below; }
   };
 
-  template<typename T, typename U>
-  class DiscreteLikelihiood<T, U, typename std::enable_if<std::is_integral<typename std::remove_reference<T>::type::elem_type>::value>::type> : public Likelihiood {
+  template<typename T, typename U, typename M>
+  class DiscreteLikelihiood<T, U, M, typename std::enable_if<std::is_integral<typename std::remove_reference<T>::type::elem_type>::value>::type> : public Likelihiood {
     const T& x_;
     const U p_;
   public:
-    DiscreteLikelihiood(const T& x, const U& p): x_(x), p_(p) { }
+    DiscreteLikelihiood(const T& x, const U& p): x_(x), p_(p) { argument<T>(x_); argument<U>(p_); }
     inline double calc() const {
       if(!arma::all(x_ >= 0) || !arma::all(x_ < (int)p_.n_elem))
         return -std::numeric_limits<double>::infinity();
       double sum = 0;
       for(unsigned i = 0; i < x_.n_elem; i++)
-        sum += log_approx(p_[x_[i]]);
-      return sum - x_.n_elem * log_approx(arma::accu(p_));
+        sum += M::log(p_[x_[i]]);
+      return sum - x_.n_elem * M::log(arma::accu(p_));
     }
+    double upper_bound() const { return x_.n_elem * (log_approx_error_above - log_approx_error_below); }
   };
 
-  template<typename T>
+  // x is data: calc() only needs the number of draws of each category
+  template<typename T, typename U, typename M = ExactMath>
+  class DiscreteSufficientLikelihiood : public Likelihiood {
+    const U p_;
+    std::vector<std::pair<int, double> > counts_;
+    double n_;
+  public:
+    DiscreteSufficientLikelihiood(const T& x, const U& p): p_(p), n_(x.n_elem) {
+      argument<U>(p_);
+      std::map<int, double> counts;
+      for(unsigned i = 0; i < x.n_elem; i++)
+        counts[x[i]] += 1;
+      counts_.assign(counts.begin(), counts.end());
+    }
+    inline double calc() const {
+      if(!counts_.empty() && (counts_.front().first < 0 || counts_.back().first >= (int)p_.n_elem))
+        return -std::numeric_limits<double>::infinity();
+      double sum = 0;
+      for(auto& c : counts_)
+        sum += c.second * M::log(p_[c.first]);
+      return sum - n_ * M::log(arma::accu(p_));
+    }
+    double upper_bound() const { return n_ * (log_approx_error_above - log_approx_error_below); }
+  };
+
+  template<typename T, typename U, typename M>
+  Likelihiood* observed_discrete(const T& x, const U& p, std::true_type) {
+    return new DiscreteLikelihiood<T, U, M>(x, p);
+  }
+
+  template<typename T, typename U, typename M>
+  Likelihiood* observed_discrete(const T& x, const U& p, std::false_type) {
+    return new DiscreteSufficientLikelihiood<T, U, M>(x, p);
+  }
+
+  template<typename T, typename M = ExactMath>
   class Discrete : public DynamicStochastic<T> {
   public:
     Discrete(T value): DynamicStochastic<T>(value) {}
 
     template<typename U>
-    Discrete<T>& ddiscr(/*const*/ U&& distr) {
-      Stochastic::likelihood_functor = new DiscreteLikelihiood<T, U>(DynamicStochastic<T>::value,distr);
+    Discrete<T, M>& ddiscr(/*const*/ U&& distr) {
+      Stochastic::likelihood_functor = new DiscreteLikelihiood<T, U, M>(DynamicStochastic<T>::value,distr);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedDiscrete : public Observed<T> {
   public:
     ObservedDiscrete(const T& value): Observed<T>(value) {}
 
     template<typename U>
-    ObservedDiscrete<int>& ddiscr(/*const*/ U&& distr) {
-      Stochastic::likelihood_functor = new DiscreteLikelihiood<T, U>(Observed<T>::value,distr);
+    ObservedDiscrete<T, M>& ddiscr(/*const*/ U&& distr) {
+      Stochastic::likelihood_functor = observed_discrete<T, U, M>(Observed<T>::value, distr, is_scalar_arg<T>());
       return *this;
     }
   };
+
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U>
+  DiscreteLikelihiood<T,U,M> ddiscr(const T& x, /*const*/ U&& distr) {
+    return DiscreteLikelihiood<T,U,M>(x, distr);
+  }
 } // namespace cppbugs
 #endif // MCMC_BERNOULLI_HPP
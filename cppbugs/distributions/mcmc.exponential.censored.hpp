@@ -25,29 +25,31 @@
 #include <cstdio>
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
+  template <typename T,typename U, typename V, typename M = ExactMath>
   class ExponentialCensoredLikelihiood : public Likelihiood {
     const T& x_;
     const U lambda_;
     const V delta_;
   public:
-    ExponentialCensoredLikelihiood(const T& x, const U& lambda, const V& delta): x_(x), lambda_(lambda), delta_(delta) { dimension_check(x_, lambda_, delta_); }
+    ExponentialCensoredLikelihiood(const T& x, const U& lambda, const V& delta): x_(x), lambda_(lambda), delta_(delta) { dimension_check(x_, lambda_, delta_);
+      argument<T>(x_); argument<U>(lambda_); argument<V>(delta_);
+    }
     inline double calc() const {
       if(!arma::all(x_ > 0))
         return -std::numeric_limits<double>::infinity();
-      return arma::accu(schur_product(delta_, log_approx(lambda_)) - schur_product(lambda_, x_));
+      return arma::accu(schur_product(delta_, M::log(lambda_)) - schur_product(lambda_, x_));
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedExponentialCensored : public Observed<T> {
   public:
     ObservedExponentialCensored(const T& value): Observed<T>(value) {}
 
     template<typename U>
-    ObservedExponentialCensored<T>& dexpcens(/*const*/ U&& lambda) {
+    ObservedExponentialCensored<T, M>& dexpcens(/*const*/ U&& lambda) {
       Stochastic::likelihood_functor =
-        new ExponentialCensoredLikelihiood<typename std::remove_reference<T>::type::first_type, U, typename std::remove_reference<T>::type::second_type>
+        new ExponentialCensoredLikelihiood<typename std::remove_reference<T>::type::first_type, U, typename std::remove_reference<T>::type::second_type, M>
            (Observed<T>::value.first,
             lambda,
             Observed<T>::value.second);
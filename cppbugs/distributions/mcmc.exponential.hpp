@@ -22,45 +22,58 @@
 #include <cmath>
 #include <armadillo>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U>
+  template <typename T,typename U, typename M = ExactMath>
   class ExponentialLikelihiood : public Likelihiood {
     const T& x_;
     const U lambda_;
   public:
-    ExponentialLikelihiood(const T& x, const U& lambda): x_(x), lambda_(lambda) { dimension_check(x_, lambda_); }
+    ExponentialLikelihiood(const T& x, const U& lambda): x_(x), lambda_(lambda) { dimension_check(x_, lambda_);
+      argument<T>(x_); argument<U>(lambda_);
+    }
     inline double calc() const {
       if(!arma::all(x_ > 0))
         return -std::numeric_limits<double>::infinity();
-      return arma::accu(log_approx(lambda_) - schur_product(lambda_, x_));
+      return arma::accu(M::log(lambda_) - schur_product(lambda_, x_));
+    }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&x_, dim_size(x_), -lambda_);
+      adj.add(&lambda_, dim_size(lambda_), 1.0/lambda_ - x_);
+      return true;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class Exponential : public DynamicStochastic<T> {
   public:
     Exponential(T value): DynamicStochastic<T>(value) {}
 
     template<typename U>
-    Exponential<T>& dexp(/*const*/ U&& lambda) {
-      Stochastic::likelihood_functor = new ExponentialLikelihiood<T,U>(DynamicStochastic<T>::value,lambda);
+    Exponential<T, M>& dexp(/*const*/ U&& lambda) {
+      Stochastic::likelihood_functor = new ExponentialLikelihiood<T,U,M>(DynamicStochastic<T>::value,lambda);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedExponential : public Observed<T> {
   public:
     ObservedExponential(const T& value): Observed<T>(value) {}
 
     template<typename U>
-    ObservedExponential<T>& dexp(/*const*/ U&& lambda) {
-      Stochastic::likelihood_functor = new ExponentialLikelihiood<T,U>(Observed<T>::value,lambda);
+    ObservedExponential<T, M>& dexp(/*const*/ U&& lambda) {
+      Stochastic::likelihood_functor = new ExponentialLikelihiood<T,U,M>(Observed<T>::value,lambda);
       return *this;
     }
   };
 
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U>
+  ExponentialLikelihiood<T,U,M> dexp(const T& x, /*const*/ U&& lambda) {
+    return ExponentialLikelihiood<T,U,M>(x, lambda);
+  }
 } // namespace cppbugs
 #endif // MCMC_EXPONENTIAL_HPP
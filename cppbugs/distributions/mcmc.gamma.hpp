@@ -22,44 +22,64 @@
 #include <cmath>
 #include <armadillo>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.conjugate.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
-  class GammaLikelihiood : public Likelihiood {
+  template <typename T,typename U, typename V, typename M = ExactMath>
+  class GammaLikelihiood : public Likelihiood, public GammaConjugate {
     const T& x_;
     const U alpha_;
     const V beta_;
   public:
-    GammaLikelihiood(const T& x, const U& alpha, const V& beta): x_(x), alpha_(alpha), beta_(beta) { dimension_check(x_, alpha_, beta_); }
+    GammaLikelihiood(const T& x, const U& alpha, const V& beta): x_(x), alpha_(alpha), beta_(beta) { dimension_check(x_, alpha_, beta_);
+      argument<T>(x_); argument<U>(alpha_); argument<V>(beta_);
+    }
     inline double calc() const {
-      return gamma_logp(x_,alpha_,beta_);
+      return gamma_logp<M>(x_,alpha_,beta_);
+    }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&x_, dim_size(x_), (alpha_ - 1.0)/x_ - beta_);
+      adj.add(&alpha_, dim_size(alpha_), M::log(x_) - digamma(alpha_) + M::log(beta_));
+      adj.add(&beta_, dim_size(beta_), alpha_/beta_ - x_);
+      return true;
     }
+    const void* x_address() const { return &x_; }
+    const void* alpha_address() const { return &alpha_; }
+    const void* beta_address() const { return &beta_; }
+    double alpha() const { return scalar_value(alpha_); }
+    double beta() const { return scalar_value(beta_); }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class Gamma : public DynamicStochastic<T> {
   public:
     Gamma(T value): DynamicStochastic<T>(value) {}
 
     template<typename U, typename V>
-    Gamma<T>& dgamma(/*const*/ U&& alpha, /*const*/ V&& beta) {
-      Stochastic::likelihood_functor = new GammaLikelihiood<T,U,V>(DynamicStochastic<T>::value,alpha,beta);
+    Gamma<T, M>& dgamma(/*const*/ U&& alpha, /*const*/ V&& beta) {
+      Stochastic::likelihood_functor = new GammaLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,alpha,beta);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedGamma : public Observed<T> {
   public:
     ObservedGamma(const T& value): Observed<T>(value) {}
 
     template<typename U, typename V>
-    ObservedGamma<T>& dgamma(/*const*/ U&& alpha, /*const*/ V&& beta) {
-      Stochastic::likelihood_functor = new GammaLikelihiood<T,U,V>(Observed<T>::value,alpha,beta);
+    ObservedGamma<T, M>& dgamma(/*const*/ U&& alpha, /*const*/ V&& beta) {
+      Stochastic::likelihood_functor = new GammaLikelihiood<T,U,V,M>(Observed<T>::value,alpha,beta);
       return *this;
     }
   };
 
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  GammaLikelihiood<T,U,V,M> dgamma(const T& x, /*const*/ U&& alpha, /*const*/ V&& beta) {
+    return GammaLikelihiood<T,U,V,M>(x, alpha, beta);
+  }
 } // namespace cppbugs
 #endif // MCMC_GAMMA_HPP
@@ -18,54 +18,99 @@
 #ifndef MCMC_MULTIVARIATE_NORMAL_HPP
 #define MCMC_MULTIVARIATE_NORMAL_HPP
 
+#include <algorithm>
 #include <armadillo>
 #include <cppbugs/mcmc.dynamic.stochastic.hpp>
 #include <cppbugs/mcmc.observed.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
+  template <typename T,typename U, typename V, typename M = ExactMath>
   class MultivariateNormalLikelihiood : public Likelihiood {
     const T& x_;
     const U mu_;
+    // covariance, or precision matrix when precision_ is set
     const V sigma_;
+    const bool precision_;
+    // cholesky factor of the last sigma_ seen, redone only when sigma_ changes
+    mutable arma::mat factored_, R_;
+    mutable bool positive_definite_;
+    void factor() const {
+      const auto& sigma = materialize(sigma_);
+      if(factored_.n_elem == sigma.n_elem && std::equal(sigma.memptr(), sigma.memptr() + sigma.n_elem, factored_.memptr())) {
+        return;
+      }
+      factored_ = sigma;
+      positive_definite_ = chol(R_, factored_);
+    }
   public:
-    MultivariateNormalLikelihiood(const T& x,  const U& mu,  const V& sigma): x_(x), mu_(mu), sigma_(sigma)
+    MultivariateNormalLikelihiood(const T& x,  const U& mu,  const V& sigma, const bool precision = false):
+      x_(x), mu_(mu), sigma_(sigma), precision_(precision), positive_definite_(true)
     {
       // need a modified dimension check
-      dimension_check(x_, mu_);
-      if(x_.n_elem != sigma_.n_rows || x_.n_elem != sigma_.n_cols) {
+      dimension_check(x_, materialize(mu_));
+      const auto& sigma_value = materialize(sigma_);
+      if(x_.n_elem != sigma_value.n_rows || x_.n_elem != sigma_value.n_cols) {
         throw std::logic_error("ERROR: dimensions of x do not match sigma");
       }
+      argument<T>(x_); argument<U>(mu_); argument<V>(sigma_);
     }
     inline double calc() const {
-      return multivariate_normal_sigma_logp(x_,mu_,sigma_);
+      factor();
+      if(!positive_definite_) {
+        return -std::numeric_limits<double>::infinity();
+      }
+      return multivariate_normal_chol_logp<M>(x_,materialize(mu_),R_,precision_);
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class MultivariateNormal : public DynamicStochastic<T> {
   public:
     MultivariateNormal(T value): DynamicStochastic<T>(value) {}
 
     template<typename U, typename V>
-    MultivariateNormal<T>& dmvnorm(/*const*/ U&& mu, /*const*/ V&& sigma) {
-      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U,V>(DynamicStochastic<T>::value,mu,sigma);
+    MultivariateNormal<T, M>& dmvnorm(/*const*/ U&& mu, /*const*/ V&& sigma) {
+      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,mu,sigma);
+      return *this;
+    }
+
+    // tau is the precision matrix
+    template<typename U, typename V>
+    MultivariateNormal<T, M>& dmvnorm_prec(/*const*/ U&& mu, /*const*/ V&& tau) {
+      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,mu,tau,true);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedMultivariateNormal : public Observed<T> {
   public:
     ObservedMultivariateNormal(const T& value): Observed<T>(value) {}
 
     template<typename U, typename V>
-    ObservedMultivariateNormal<T>& dmvnorm(/*const*/ U&& mu, /*const*/ V&& sigma) {
-      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U,V>(Observed<T>::value,mu,sigma);
+    ObservedMultivariateNormal<T, M>& dmvnorm(/*const*/ U&& mu, /*const*/ V&& sigma) {
+      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U,V,M>(Observed<T>::value,mu,sigma);
+      return *this;
+    }
+
+    // tau is the precision matrix
+    template<typename U, typename V>
+    ObservedMultivariateNormal<T, M>& dmvnorm_prec(/*const*/ U&& mu, /*const*/ V&& tau) {
+      Stochastic::likelihood_functor = new MultivariateNormalLikelihiood<T,U,V,M>(Observed<T>::value,mu,tau,true);
       return *this;
     }
   };
 
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  MultivariateNormalLikelihiood<T,U,V,M> dmvnorm(const T& x, /*const*/ U&& mu, /*const*/ V&& sigma) {
+    return MultivariateNormalLikelihiood<T,U,V,M>(x, mu, sigma);
+  }
+
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  MultivariateNormalLikelihiood<T,U,V,M> dmvnorm_prec(const T& x, /*const*/ U&& mu, /*const*/ V&& tau) {
+    return MultivariateNormalLikelihiood<T,U,V,M>(x, mu, tau, true);
+  }
 } // namespace cppbugs
 #endif // MCMC_MULTIVARIATE_NORMAL_HPP
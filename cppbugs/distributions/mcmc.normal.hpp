@@ -21,44 +21,110 @@
 #include <armadillo>
 #include <cppbugs/mcmc.dynamic.stochastic.hpp>
 #include <cppbugs/mcmc.observed.hpp>
+#include <cppbugs/mcmc.conjugate.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
-  class NormalLikelihiood : public Likelihiood {
+  template <typename T,typename U, typename V, typename M = ExactMath>
+  class NormalLikelihiood : public Likelihiood, public NormalConjugate {
     const T& x_;
     const U mu_;
     const V tau_;
   public:
-    NormalLikelihiood(const T& x, const U& mu, const V& tau): x_(x), mu_(mu), tau_(tau) { dimension_check(x_, mu_, tau_); }
+    NormalLikelihiood(const T& x, const U& mu, const V& tau): x_(x), mu_(mu), tau_(tau) { dimension_check(x_, mu_, tau_);
+      argument<T>(x_); argument<U>(mu_); argument<V>(tau_);
+    }
+    inline double calc() const {
+      return normal_logp<M>(x_,mu_,tau_);
+    }
+    size_t elements() const { return chunkable(x_) && chunkable(mu_) && chunkable(tau_) ? dim_size(x_) : 0; }
+    double calc_chunk(const size_t first, const size_t last) const {
+      return normal_logp<M>(chunk(x_,first,last),chunk(mu_,first,last),chunk(tau_,first,last));
+    }
+    bool gradient(Adjoints& adj) const {
+      adj.add(&x_, dim_size(x_), -schur_product(tau_, x_ - mu_));
+      adj.add(&mu_, dim_size(mu_), schur_product(tau_, x_ - mu_));
+      adj.add(&tau_, dim_size(tau_), 0.5/tau_ - 0.5 * square(x_ - mu_));
+      return true;
+    }
+    const void* x_address() const { return &x_; }
+    const void* mu_address() const { return &mu_; }
+    const void* tau_address() const { return &tau_; }
+    double mu() const { return scalar_value(mu_); }
+    double tau() const { return scalar_value(tau_); }
+    double n() const { return dim_size(x_); }
+    double tau_sum() const { return broadcast_sum(tau_, x_); }
+    double tau_x_sum() const { return weighted_sum(tau_, x_); }
+    double squared_error() const { return arma::accu(square(x_ - mu_)); }
+  };
+
+  // x is data and mu, tau are scalars: calc() only needs n, the mean and the
+  // sum of squared deviations of x, computed once
+  template <typename T,typename U, typename V, typename M = ExactMath>
+  class NormalSufficientLikelihiood : public NormalLikelihiood<T,U,V,M> {
+    double n_, mean_, ss_;
+  public:
+    NormalSufficientLikelihiood(const T& x, const U& mu, const V& tau): NormalLikelihiood<T,U,V,M>(x, mu, tau),
+      n_(dim_size(x)), mean_(0), ss_(0) {
+      for(size_t i = 0; i < x.n_elem; i++) { mean_ += x[i]; }
+      mean_ = n_ ? mean_ / n_ : 0;
+      for(size_t i = 0; i < x.n_elem; i++) { ss_ += square(x[i] - mean_); }
+    }
     inline double calc() const {
-      return normal_logp(x_,mu_,tau_);
+      const double tau = this->tau();
+      return n_ * (0.5f*M::log(0.5f*tau/arma::math::pi())) - 0.5f * tau * squared_error();
     }
+    size_t elements() const { return 0; }
+    bool gradient(Adjoints& adj) const {
+      const double mu = this->mu(), tau = this->tau();
+      adj.add(this->mu_address(), 1, tau * n_ * (mean_ - mu));
+      adj.add(this->tau_address(), 1, 0.5 * n_ / tau - 0.5 * squared_error());
+      return true;
+    }
+    double tau_x_sum() const { return this->tau() * n_ * mean_; }
+    double squared_error() const { return ss_ + n_ * square(mean_ - this->mu()); }
   };
 
-  template<typename T>
+  template<typename T, typename U, typename V, typename M>
+  Likelihiood* observed_normal(const T& x, const U& mu, const V& tau, std::false_type) {
+    return new NormalLikelihiood<T,U,V,M>(x, mu, tau);
+  }
+
+  template<typename T, typename U, typename V, typename M>
+  Likelihiood* observed_normal(const T& x, const U& mu, const V& tau, std::true_type) {
+    return new NormalSufficientLikelihiood<T,U,V,M>(x, mu, tau);
+  }
+
+  template<typename T, typename M = ExactMath>
   class Normal : public DynamicStochastic<T> {
   public:
     Normal(T value): DynamicStochastic<T>(value) {}
 
     template<typename U, typename V>
-    Normal<T>& dnorm(/*const*/ U&& mu, /*const*/ V&& tau) {
-      Stochastic::likelihood_functor = new NormalLikelihiood<T,U,V>(DynamicStochastic<T>::value,mu,tau);
+    Normal<T, M>& dnorm(/*const*/ U&& mu, /*const*/ V&& tau) {
+      Stochastic::likelihood_functor = new NormalLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,mu,tau);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedNormal : public Observed<T> {
   public:
     ObservedNormal(const T& value): Observed<T>(value) {}
 
     template<typename U, typename V>
-    ObservedNormal<T>& dnorm(/*const*/ U&& mu, /*const*/ V&& tau) {
-      Stochastic::likelihood_functor = new NormalLikelihiood<T,U,V>(Observed<T>::value,mu,tau);
+    ObservedNormal<T, M>& dnorm(/*const*/ U&& mu, /*const*/ V&& tau) {
+      Stochastic::likelihood_functor = observed_normal<T,U,V,M>(Observed<T>::value, mu, tau,
+        std::integral_constant<bool, !is_scalar_arg<T>::value && is_scalar_arg<U>::value && is_scalar_arg<V>::value>());
       return *this;
     }
   };
 
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  NormalLikelihiood<T,U,V,M> dnorm(const T& x, /*const*/ U&& mu, /*const*/ V&& tau) {
+    return NormalLikelihiood<T,U,V,M>(x, mu, tau);
+  }
 } // namespace cppbugs
 #endif // MCMC_NORMAL_HPP
@@ -22,45 +22,58 @@
 #include <cmath>
 #include <armadillo>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
 
 namespace cppbugs {
 
-  template <typename T,typename U, typename V>
+  template <typename T,typename U, typename V, typename M = ExactMath>
   class UniformLikelihiood : public Likelihiood {
     const T& x_;
     const U lower_;
     const V upper_;
   public:
-    UniformLikelihiood(const T& x, const U& lower, const V& upper): x_(x), lower_(lower), upper_(upper) { dimension_check(x_, lower_, upper_); }
+    UniformLikelihiood(const T& x, const U& lower, const V& upper): x_(x), lower_(lower), upper_(upper) { dimension_check(x_, lower_, upper_);
+      argument<T>(x_); argument<U>(lower_); argument<V>(upper_);
+    }
     inline double calc() const {
-      return uniform_logp(x_,lower_,upper_);
+      return uniform_logp<M>(x_,lower_,upper_);
+    }
+    // flat in x inside the bounds
+    bool gradient(Adjoints& adj) const {
+      adj.add(&lower_, dim_size(lower_), 1.0/(upper_ - lower_));
+      adj.add(&upper_, dim_size(upper_), -1.0/(upper_ - lower_));
+      return true;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class Uniform : public DynamicStochastic<T> {
   public:
     Uniform(T value): DynamicStochastic<T>(value) {}
 
     template<typename U, typename V>
-    Uniform<T>& dunif(/*const*/ U&& lower, /*const*/ V&& upper) {
-      Stochastic::likelihood_functor = new UniformLikelihiood<T,U,V>(DynamicStochastic<T>::value,lower,upper);
+    Uniform<T, M>& dunif(/*const*/ U&& lower, /*const*/ V&& upper) {
+      Stochastic::likelihood_functor = new UniformLikelihiood<T,U,V,M>(DynamicStochastic<T>::value,lower,upper);
       return *this;
     }
   };
 
-  template<typename T>
+  template<typename T, typename M = ExactMath>
   class ObservedUniform : public Observed<T> {
   public:
     ObservedUniform(const T& value): Observed<T>(value) {}
 
     template<typename U, typename V>
-    ObservedUniform<T>& dunif(/*const*/ U&& lower, /*const*/ V&& upper) {
-      Stochastic::likelihood_functor = new UniformLikelihiood<T,U,V>(Observed<T>::value,lower,upper);
+    ObservedUniform<T, M>& dunif(/*const*/ U&& lower, /*const*/ V&& upper) {
+      Stochastic::likelihood_functor = new UniformLikelihiood<T,U,V,M>(Observed<T>::value,lower,upper);
       return *this;
     }
   };
 
-
+  // the likelihood of x by value, for StaticModel
+  template<typename M = ExactMath, typename T, typename U, typename V>
+  UniformLikelihiood<T,U,V,M> dunif(const T& x, /*const*/ U&& lower, /*const*/ V&& upper) {
+    return UniformLikelihiood<T,U,V,M>(x, lower, upper);
+  }
 } // namespace cppbugs
 #endif // MCMC_UNIFORM_HPP
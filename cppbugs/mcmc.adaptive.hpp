@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_ADAPTIVE_HPP
+#define MCMC_ADAPTIVE_HPP
+
+#include <cmath>
+#include <armadillo>
+#include <cppbugs/mcmc.math.hpp>
+#include <cppbugs/mcmc.jump.hpp>
+#include <cppbugs/mcmc.rng.base.hpp>
+#include <cppbugs/mcmc.serialize.hpp>
+
+namespace cppbugs {
+
+  // running covariance of the draws of a vector node
+  // Haario, Saksman and Tamminen, Bernoulli 7(2) 2001
+  //
+  // only the lower cholesky factor of the sum of squared deviations is kept,
+  // and each draw updates it in O(d^2) with a rank-one update
+  class AdaptiveCovariance {
+    double n_;
+    arma::vec mean_;
+    arma::mat chol_;
+  public:
+    AdaptiveCovariance(): n_(0) {}
+
+    // eps is the variance of the regularization added to the first draw
+    void add(const arma::vec& x, const double eps) {
+      n_ += 1;
+      if(n_ == 1) {
+        mean_ = x;
+        chol_ = arma::eye<arma::mat>(x.n_elem, x.n_elem) * std::sqrt(eps);
+        return;
+      }
+      arma::vec delta = x - mean_;
+      mean_ += delta / n_;
+      delta *= std::sqrt((n_ - 1) / n_);
+      chol_update(chol_, delta);
+    }
+
+    void write(std::ostream& out) const {
+      write_binary(out, n_);
+      write_binary(out, mean_);
+      write_binary(out, chol_);
+    }
+
+    void read(std::istream& in) {
+      read_binary(in, n_);
+      read_binary(in, mean_);
+      read_binary(in, chol_);
+    }
+
+    // wait for a few draws per dimension before trusting the estimate
+    bool ready() const { return n_ > 2 * mean_.n_elem + 10; }
+
+    // x += scale * chol(cov) * z
+    template<typename R>
+    void jump(R& rng, arma::vec& x, const double scale) const {
+      arma::vec z(x.n_elem);
+      rng.normal(z.memptr(), z.n_elem);
+      x += (scale / std::sqrt(n_ - 1)) * (arma::trimatl(chol_) * z);
+    }
+  };
+
+  // only vectors are adapted, other types keep the plain random walk
+  void adaptive_add(AdaptiveCovariance& cov, const arma::vec& x, const double eps) {
+    cov.add(x, eps);
+  }
+
+  template<typename T>
+  void adaptive_add(AdaptiveCovariance&, const T&, const double) {}
+
+  template<typename R>
+  void adaptive_jump(const AdaptiveCovariance& cov, R& rng, arma::vec& x, const double scale) {
+    cov.jump(rng, x, scale);
+  }
+
+  template<typename R, typename T>
+  void adaptive_jump(const AdaptiveCovariance&, R& rng, T& x, const double scale) {
+    jump_impl(rng, x, scale);
+  }
+
+} // namespace cppbugs
+#endif // MCMC_ADAPTIVE_HPP
@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_CHECKPOINT_HPP
+#define MCMC_CHECKPOINT_HPP
+
+#include <cstdio>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+namespace cppbugs {
+
+  // writes checkpoints from a background thread, so that sampling only waits
+  // for the state to be copied to memory.  each checkpoint goes to path.tmp
+  // which is then renamed over path, so path always holds a complete one.
+  class CheckpointWriter {
+  private:
+    std::string path_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string pending_;
+    bool has_pending_, writing_, stop_, failed_;
+    std::thread thread_;
+
+    void fail() const {
+      throw std::logic_error("ERROR: cannot write checkpoint " + path_ + ".");
+    }
+
+    bool save(const std::string& data) const {
+      const std::string tmp = path_ + ".tmp";
+      {
+        std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+        if(!out) { return false; }
+      }
+      return std::rename(tmp.c_str(), path_.c_str()) == 0;
+    }
+
+    void worker() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for(;;) {
+        cv_.wait(lock, [this]() { return stop_ || has_pending_; });
+        if(has_pending_) {
+          std::string data;
+          data.swap(pending_);
+          has_pending_ = false;
+          writing_ = true;
+          lock.unlock();
+          const bool ok = save(data);
+          lock.lock();
+          writing_ = false;
+          failed_ = failed_ || !ok;
+          cv_.notify_all();
+        } else {
+          return;
+        }
+      }
+    }
+  public:
+    CheckpointWriter(const std::string& path):
+      path_(path), has_pending_(false), writing_(false), stop_(false), failed_(false),
+      thread_(&CheckpointWriter::worker, this) {}
+
+    // waits for the last checkpoint to be written
+    ~CheckpointWriter() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      thread_.join();
+    }
+
+    const std::string& path() const { return path_; }
+
+    // waits for the pending checkpoint, and throws if any write failed
+    void wait() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return !has_pending_ && !writing_; });
+      if(failed_) { fail(); }
+    }
+
+    // a checkpoint not yet written is replaced by the newer one
+    void write(std::string& data) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(failed_) { fail(); }
+      pending_.swap(data);
+      has_pending_ = true;
+      cv_.notify_all();
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_CHECKPOINT_HPP
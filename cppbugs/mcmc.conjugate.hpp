@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_CONJUGATE_HPP
+#define MCMC_CONJUGATE_HPP
+
+#include <cmath>
+#include <vector>
+#include <type_traits>
+#include <armadillo>
+#include <cppbugs/mcmc.math.hpp>
+#include <cppbugs/mcmc.rng.base.hpp>
+
+namespace cppbugs {
+
+  // interfaces implemented by the likelihoods which take part in conjugate pairs
+  // the scalar accessors are only used when the corresponding argument is a scalar node
+
+  class NormalConjugate {
+  public:
+    virtual ~NormalConjugate() {}
+    virtual const void* x_address() const = 0;
+    virtual const void* mu_address() const = 0;
+    virtual const void* tau_address() const = 0;
+    virtual double mu() const = 0;
+    virtual double tau() const = 0;
+    // number of elements of x
+    virtual double n() const = 0;
+    // sum(tau), sum(tau % x) and sum((x - mu)^2) over the elements of x
+    virtual double tau_sum() const = 0;
+    virtual double tau_x_sum() const = 0;
+    virtual double squared_error() const = 0;
+  };
+
+  class GammaConjugate {
+  public:
+    virtual ~GammaConjugate() {}
+    virtual const void* x_address() const = 0;
+    virtual const void* alpha_address() const = 0;
+    virtual const void* beta_address() const = 0;
+    virtual double alpha() const = 0;
+    virtual double beta() const = 0;
+  };
+
+  class BetaConjugate {
+  public:
+    virtual ~BetaConjugate() {}
+    virtual const void* x_address() const = 0;
+    virtual const void* alpha_address() const = 0;
+    virtual const void* beta_address() const = 0;
+    virtual double alpha() const = 0;
+    virtual double beta() const = 0;
+  };
+
+  // binomial and bernoulli likelihoods
+  class BinomialConjugate {
+  public:
+    virtual ~BinomialConjugate() {}
+    virtual const void* x_address() const = 0;
+    virtual const void* n_address() const = 0;
+    virtual const void* p_address() const = 0;
+    virtual double successes() const = 0;
+    virtual double failures() const = 0;
+  };
+
+  template<typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value, double>::type
+  scalar_value(const T x) { return x; }
+
+  template<typename T>
+  typename std::enable_if<!std::is_arithmetic<T>::value, double>::type
+  scalar_value(const T& x) { return arma::as_scalar(x); }
+
+  // sum over the elements of x of w, broadcasting w when it is a scalar
+  template<typename W, typename T>
+  typename std::enable_if<std::is_arithmetic<W>::value, double>::type
+  broadcast_sum(const W w, const T& x) { return w * dim_size(x); }
+
+  template<typename W, typename T>
+  typename std::enable_if<!std::is_arithmetic<W>::value, double>::type
+  broadcast_sum(const W& w, const T&) { return arma::accu(w); }
+
+  // sum over the elements of x of w * x
+  template<typename W, typename T>
+  typename std::enable_if<std::is_arithmetic<W>::value, double>::type
+  weighted_sum(const W w, const T& x) { return w * arma::accu(x); }
+
+  template<typename W, typename T>
+  typename std::enable_if<!std::is_arithmetic<W>::value, double>::type
+  weighted_sum(const W& w, const T& x) { return arma::accu(w % x); }
+
+  // Marsaglia and Tsang, ACM TOMS 26(3) 2000
+  double rgamma(RngBase& rng, const double shape, const double rate) {
+    if(shape < 1) {
+      return rgamma(rng, shape + 1, rate) * std::pow(rng.uniform(), 1 / shape);
+    }
+    const double d = shape - 1.0/3.0;
+    const double c = 1 / std::sqrt(9 * d);
+    for(;;) {
+      double x, v;
+      do {
+        x = rng.normal();
+        v = 1 + c * x;
+      } while(v <= 0);
+      v = v * v * v;
+      const double u = rng.uniform();
+      if(u < 1 - 0.0331 * x * x * x * x || std::log(u) < 0.5 * x * x + d * (1 - v + std::log(v))) {
+        return d * v / rate;
+      }
+    }
+  }
+
+  double rbeta(RngBase& rng, const double alpha, const double beta) {
+    const double x = rgamma(rng, alpha, 1);
+    const double y = rgamma(rng, beta, 1);
+    return x / (x + y);
+  }
+
+  // draws a scalar node from its closed form full conditional
+  class GibbsStep {
+  public:
+    virtual ~GibbsStep() {}
+    virtual void step(RngBase& rng) = 0;
+  };
+
+  // normal prior on the mean of normal children
+  class NormalMeanStep : public GibbsStep {
+    double& value_;
+    const NormalConjugate* prior_;
+    std::vector<const NormalConjugate*> children_;
+  public:
+    NormalMeanStep(double& value, const NormalConjugate* prior, const std::vector<const NormalConjugate*>& children):
+      value_(value), prior_(prior), children_(children) {}
+    void step(RngBase& rng) {
+      double precision = prior_->tau();
+      double mean = prior_->tau() * prior_->mu();
+      for(auto c : children_) {
+        precision += c->tau_sum();
+        mean += c->tau_x_sum();
+      }
+      value_ = mean / precision + rng.normal() / std::sqrt(precision);
+    }
+  };
+
+  // gamma prior on the precision of normal children
+  class GammaPrecisionStep : public GibbsStep {
+    double& value_;
+    const GammaConjugate* prior_;
+    std::vector<const NormalConjugate*> children_;
+  public:
+    GammaPrecisionStep(double& value, const GammaConjugate* prior, const std::vector<const NormalConjugate*>& children):
+      value_(value), prior_(prior), children_(children) {}
+    void step(RngBase& rng) {
+      double shape = prior_->alpha();
+      double rate = prior_->beta();
+      for(auto c : children_) {
+        shape += c->n() / 2;
+        rate += c->squared_error() / 2;
+      }
+      value_ = rgamma(rng, shape, rate);
+    }
+  };
+
+  // beta prior on the probability of binomial or bernoulli children
+  class BetaBinomialStep : public GibbsStep {
+    double& value_;
+    const BetaConjugate* prior_;
+    std::vector<const BinomialConjugate*> children_;
+  public:
+    BetaBinomialStep(double& value, const BetaConjugate* prior, const std::vector<const BinomialConjugate*>& children):
+      value_(value), prior_(prior), children_(children) {}
+    void step(RngBase& rng) {
+      double alpha = prior_->alpha();
+      double beta = prior_->beta();
+      for(auto c : children_) {
+        alpha += c->successes();
+        beta += c->failures();
+      }
+      value_ = rbeta(rng, alpha, beta);
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_CONJUGATE_HPP
@@ -30,6 +30,7 @@ namespace cppbugs {
     void accept() {}
     void reject(){}
     void tune() {}
+    void adapt() {}
     // in Dynamic: void preserve()
     // in Dynamic: void revert()
     // in Dynamic: void tally()
@@ -19,24 +19,42 @@
 #define MCMC_DYNAMIC_HPP
 
 #include <vector>
+#include <memory>
+#include <limits>
+#include <string>
+#include <utility>
+#include <type_traits>
 #include <cppbugs/mcmc.math.hpp>
 #include <cppbugs/mcmc.object.hpp>
+#include <cppbugs/mcmc.serialize.hpp>
+#include <cppbugs/mcmc.trace.hpp>
+#include <cppbugs/mcmc.summary.hpp>
+#include <cppbugs/mcmc.history.hpp>
 
 namespace cppbugs {
 
   template<typename T>
   class Dynamic;
 
+  inline void swap_buffers(double& a, double& b) { std::swap(a, b); }
+  inline void swap_buffers(int& a, int& b) { std::swap(a, b); }
+  template<typename eT>
+  void swap_buffers(arma::Mat<eT>& a, arma::Mat<eT>& b) { a.swap(b); }
+
   template<typename T>
   class Dynamic<T&> : public MCMCObject {
     bool save_history_;
+    bool double_buffered_;
+    std::unique_ptr<TraceWriter> trace_;
+    std::unique_ptr<Summary> summary_;
 
+    static unsigned long long no_trace() { return std::numeric_limits<unsigned long long>::max(); }
   public:
-    std::vector<T> history;
+    History<T> history;
     T& value;
     T old_value;
 
-    Dynamic(T& shape): MCMCObject(), save_history_(true), value(shape), old_value(shape) {}
+    Dynamic(T& shape): MCMCObject(), save_history_(true), double_buffered_(false), history(shape), value(shape), old_value(shape) {}
 
     static void fill(arma::ivec& x) { x.fill(0); }
     static void fill(arma::mat& x) { x.fill(0); }
@@ -50,7 +68,7 @@ namespace cppbugs {
 
       T ans(*history.begin());
       fill(ans);
-      for(T v : history)
+      for(const T& v : history)
         ans += v;
       ans /= static_cast<double>(history.size());
       return ans;
@@ -60,10 +78,72 @@ namespace cppbugs {
       save_history_ = save_history;
     }
 
-    void preserve() { old_value = value; }
-    void revert() { value = old_value; }
-    void tally() { if(save_history_) { history.push_back(value); } }
+    // streams the tallied draws to a trace file, appending if it exists
+    // combine with setSaveHistory(false) for nodes too large to keep in memory
+    void setTrace(const std::string& path, const size_t chunk_rows = 0) {
+      if(trace_) { trace_->close(); }
+      trace_.reset(path.empty() ? nullptr : new TraceWriter(path, chunk_rows));
+    }
+
+    // keeps running summaries of the draws in place of the history
+    void setSummary(const std::vector<double>& probs = {0.025, 0.5, 0.975}) {
+      summary_.reset(new Summary(probs));
+      save_history_ = false;
+    }
+
+    const Summary& summary() const {
+      if(!summary_) {
+        throw std::logic_error("ERROR: no summary for this node, call setSummary first.");
+      }
+      return *summary_;
+    }
+
+    void reserve(const size_t draws) {
+      if(save_history_) { history.reserve(history.size() + draws); }
+    }
+
+    // armadillo values swap buffers with old_value instead of being copied,
+    // so after preserve() value must be rewritten entirely (by a jump or update())
+    void setDoubleBuffered(const bool double_buffered) { double_buffered_ = double_buffered; }
+    bool buffered() const { return double_buffered_ && !std::is_arithmetic<T>::value; }
+
+    void preserve() { if(buffered()) { swap_buffers(value, old_value); } else { old_value = value; } }
+    void revert() { if(buffered()) { swap_buffers(value, old_value); } else { value = old_value; } }
+    void tally() {
+      if(save_history_) { history.push_back(value); }
+      if(trace_) { trace_->add(value); }
+      if(summary_) { summary_->add(value); }
+    }
+    void flush() { if(trace_) { trace_->flush(); } }
     double size() const { return dim_size(value); }
+    const void* address() const { return &value; }
+    void exchange(MCMCObject& other) { std::swap(value, dynamic_cast<Dynamic<T&>&>(other).value); }
+    // the number of draws in the trace, so that resume() drops those written after
+    // the checkpoint, and the summary, so that it carries on over the resumed draws
+    void write(std::ostream& out) const {
+      write_binary(out, value);
+      write_binary(out, static_cast<unsigned long long>(trace_ ? trace_->rows() : no_trace()));
+      write_binary(out, static_cast<bool>(summary_));
+      if(summary_) { summary_->write(out); }
+    }
+    void read(std::istream& in) {
+      unsigned long long trace_rows;
+      bool has_summary;
+      read_binary(in, value);
+      read_binary(in, trace_rows);
+      if(trace_ && trace_rows != no_trace()) { trace_->truncate(trace_rows); }
+      read_binary(in, has_summary);
+      if(has_summary) {
+        std::unique_ptr<Summary> summary(new Summary(std::vector<double>()));
+        summary->read(in);
+        if(summary_) {
+          if(summary->probs() != summary_->probs()) {
+            throw std::logic_error("ERROR: the quantiles of the checkpointed summary differ from setSummary.");
+          }
+          summary_.swap(summary);
+        }
+      }
+    }
   };
 
 } // namespace cppbugs
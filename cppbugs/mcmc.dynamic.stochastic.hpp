@@ -22,6 +22,8 @@
 #include <cppbugs/mcmc.dynamic.hpp>
 #include <cppbugs/mcmc.stochastic.hpp>
 #include <cppbugs/mcmc.jump.hpp>
+#include <cppbugs/mcmc.adaptive.hpp>
+#include <cppbugs/mcmc.slice.hpp>
 #include <cppbugs/mcmc.math.hpp>
 
 namespace cppbugs {
@@ -29,12 +31,16 @@ namespace cppbugs {
   template<typename T>
   class DynamicStochastic : public Dynamic<T>, public Stochastic  {
   protected:
-    double accepted_,rejected_,scale_,target_ar_;
+    double accepted_,rejected_,scale_,target_ar_,initial_scale_;
+    bool adaptive_;
+    AdaptiveCovariance cov_;
+    StepMethod step_method_;
   public:
-    DynamicStochastic(T value): Dynamic<T>(value), accepted_(0), rejected_(0) {
+    DynamicStochastic(T value): Dynamic<T>(value), accepted_(0), rejected_(0), adaptive_(false), step_method_(StepMethod::metropolis) {
       const double scale_num = 2.38;
       double ideal_scale = sqrt(scale_num / pow(dim_size(Dynamic<T>::value),2));
       scale_ = ideal_scale > 1.0 ? 1.0 : ideal_scale;
+      initial_scale_ = scale_;
 
       // heuristic to set the target acceptance ratio based on the size of the object
       // limiting the target ar to the theoretical asymptotic minimum of 0.234
@@ -42,7 +48,25 @@ namespace cppbugs {
       target_ar_ = std::max(1/log2(dim_size(Dynamic<T>::value) + 3),0.234);
     }
     virtual ~DynamicStochastic() {}
-    void jump(RngBase& rng) { jump_impl(rng,Dynamic<T>::value,scale_); }
+    // slice sampled nodes are moved by the model, not jumped
+    // MCModel calls it with its own generator type, so the draws inline
+    template<typename R>
+    void jump_with(R& rng) {
+      if(step_method_ == StepMethod::slice) {
+        return;
+      }
+      if(adaptive_ && cov_.ready()) {
+        // optimal scaling of the covariance is 2.38^2/d, adjusted by the tuning of scale_
+        const double cov_scale = 2.38 / sqrt(dim_size(Dynamic<T>::value)) * scale_ / initial_scale_;
+        if(Dynamic<T>::buffered()) { Dynamic<T>::value = Dynamic<T>::old_value; }
+        adaptive_jump(cov_, rng, Dynamic<T>::value, cov_scale);
+      } else if(Dynamic<T>::buffered()) {
+        jump_impl(rng, Dynamic<T>::value, Dynamic<T>::old_value, scale_);
+      } else {
+        jump_impl(rng,Dynamic<T>::value,scale_);
+      }
+    }
+    void jump(RngBase& rng) { jump_with(rng); }
     void accept() { accepted_ += 1; }
     void reject() { rejected_ += 1; }
     void tune() {
@@ -52,12 +76,51 @@ namespace cppbugs {
       double acceptance_ratio = accepted_ / (accepted_ + rejected_);
       accepted_ = 0;
       rejected_ = 0;
+      if(step_method_ == StepMethod::slice) {
+        return;
+      }
 
       double diff = acceptance_ratio - target_ar_;
       if(std::abs(diff) > thresh) {
         scale_ *= (1.0 + diff * dilution);
       }
     }
+    // records the current value in the running covariance
+    void adapt() {
+      if(adaptive_) {
+        adaptive_add(cov_, Dynamic<T>::value, initial_scale_ * initial_scale_);
+      }
+    }
+    // propose from the covariance of the draws seen during tuning (vector nodes only)
+    void setAdaptive(const bool adaptive) {
+      if(adaptive && !std::is_same<typename std::remove_reference<T>::type, arma::vec>::value) {
+        throw std::logic_error("ERROR: adaptive proposals are only available for vector nodes.");
+      }
+      adaptive_ = adaptive;
+    }
+    // slice sampling is only available for scalar double nodes, and uses
+    // the scale as the initial width of the slice
+    void setStepMethod(const StepMethod step_method) {
+      if(step_method == StepMethod::slice && !std::is_same<typename std::remove_reference<T>::type, double>::value) {
+        throw std::logic_error("ERROR: slice sampling is only available for double nodes.");
+      }
+      step_method_ = step_method;
+    }
+    StepMethod getStepMethod() const { return step_method_; }
+    void write(std::ostream& out) const {
+      Dynamic<T>::write(out);
+      write_binary(out, scale_);
+      write_binary(out, accepted_);
+      write_binary(out, rejected_);
+      cov_.write(out);
+    }
+    void read(std::istream& in) {
+      Dynamic<T>::read(in);
+      read_binary(in, scale_);
+      read_binary(in, accepted_);
+      read_binary(in, rejected_);
+      cov_.read(in);
+    }
     // in Dynamic: void preserve()
     // in Dynamic: void revert()
     // in Dynamic: void tally()
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_FACTLN_HPP
+#define MCMC_FACTLN_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <cppbugs/mcmc.simd.hpp>
+
+#ifdef CPPBUGS_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// log(i!) is read from a table for i < CPPBUGS_FACTLN_TABLE_SIZE
+#ifndef CPPBUGS_FACTLN_TABLE_SIZE
+#define CPPBUGS_FACTLN_TABLE_SIZE 1024
+#endif
+
+namespace cppbugs {
+  namespace simd {
+
+    class FactlnTable {
+      double values_[CPPBUGS_FACTLN_TABLE_SIZE];
+    public:
+      static const int size = CPPBUGS_FACTLN_TABLE_SIZE;
+      static_assert(size > 0, "the factln table needs at least one entry");
+      FactlnTable() {
+        for(int i = 0; i < size; i++) {
+          values_[i] = std::lgamma(double(i) + 1);
+        }
+      }
+      const double* data() const { return values_; }
+    };
+
+    // built on first use, the initialization of a local static is thread
+    // safe, and only read afterwards, so all threads and models share it
+    inline const double* factln_table() {
+      static const FactlnTable table;
+      return table.data();
+    }
+
+    // log(i!) of the integer part of x: -inf below 0, lgamma above the table
+    inline double factln_outside(const double x) {
+      return x < 0 ? -std::numeric_limits<double>::infinity() : lgamma(std::floor(x) + 1);
+    }
+
+    inline double factln(const double x) {
+      return x > -1 && x < FactlnTable::size ? factln_table()[static_cast<int>(x)] : factln_outside(x);
+    }
+
+    inline void factln_scalar(const double* x, double* out, const size_t n) {
+      for(size_t i = 0; i < n; i++) {
+        out[i] = factln(x[i]);
+      }
+    }
+
+#ifdef CPPBUGS_SIMD_X86
+    // gathers 4 entries at a time, groups with a value outside the table go
+    // through the scalar version
+    __attribute__((target("avx2"))) inline void factln_avx2(const double* x, double* out, const size_t n) {
+      const double* table = factln_table();
+      const __m256d lower = _mm256_set1_pd(-1), upper = _mm256_set1_pd(FactlnTable::size);
+      size_t i = 0;
+      for(; i + 4 <= n; i += 4) {
+        const __m256d v = _mm256_loadu_pd(x + i);
+        const __m256d inside = _mm256_and_pd(_mm256_cmp_pd(v, lower, _CMP_GT_OQ), _mm256_cmp_pd(v, upper, _CMP_LT_OQ));
+        if(_mm256_movemask_pd(inside) == 0xF) {
+          _mm256_storeu_pd(out + i, _mm256_i32gather_pd(table, _mm256_cvttpd_epi32(v), 8));
+        } else {
+          factln_scalar(x + i, out + i, 4);
+        }
+      }
+      factln_scalar(x + i, out + i, n - i);
+    }
+#endif
+
+    inline bulk_function select_factln() {
+#ifdef CPPBUGS_SIMD_X86
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx2")) {
+        return factln_avx2;
+      }
+#endif
+      return factln_scalar;
+    }
+
+    // out may be x
+    inline void factln(const double* x, double* out, const size_t n) {
+      static const bulk_function f = select_factln();
+      f(x, out, n);
+    }
+
+  } // namespace simd
+} // namespace cppbugs
+#endif // MCMC_FACTLN_HPP
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_GRADIENT_HPP
+#define MCMC_GRADIENT_HPP
+
+#include <map>
+#include <set>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <armadillo>
+#include <cppbugs/mcmc.object.hpp>
+#include <cppbugs/mcmc.dynamic.hpp>
+
+namespace cppbugs {
+
+  // derivatives of the model logp with respect to the variables it reads,
+  // accumulated in reverse: the likelihoods add the derivatives with respect
+  // to their arguments, then the function given to MCModel::setGradient adds
+  // the derivatives of the variables computed in update() to their parents, ie
+  // for phi = fixed*b:
+  //
+  //   m.setGradient([&](Adjoints& adj) { adj(b) += fixed.t() * adj(phi); });
+  class Adjoints {
+    std::map<const void*, arma::vec> values_;
+    std::set<const void*> tracked_;
+
+    template<typename E>
+    static typename std::enable_if<std::is_arithmetic<E>::value>::type
+    accumulate(arma::vec& a, const E g) { a += g; }
+
+    // arguments broadcast over x get the sum of the elementwise derivatives
+    template<typename E>
+    static typename std::enable_if<!std::is_arithmetic<E>::value>::type
+    accumulate(arma::vec& a, const E& g) {
+      if(a.n_elem == 1) {
+        a[0] += arma::accu(g);
+      } else {
+        a += arma::vectorise(g);
+      }
+    }
+  public:
+    // only the derivatives of tracked variables are kept
+    void track(const void* address) { tracked_.insert(address); }
+    bool tracks(const void* address) const { return tracked_.count(address) > 0; }
+    void clear() {
+      for(auto& v : values_) {
+        v.second.zeros();
+      }
+    }
+
+    // g is the derivative with respect to an argument with n elements,
+    // either a scalar or an expression with the dimensions of the likelihood's x
+    template<typename E>
+    void add(const void* address, const double n, const E& g) {
+      if(!tracks(address)) { return; }
+      arma::vec& a = values_[address];
+      if(a.n_elem != n) { a.zeros(n); }
+      accumulate(a, g);
+    }
+
+    double& operator()(const double& x) {
+      arma::vec& a = values_[&x];
+      if(a.n_elem != 1) { a.zeros(1); }
+      return a[0];
+    }
+
+    // flattened in column major order for matrices
+    arma::vec& operator()(const arma::mat& x) {
+      arma::vec& a = values_[&x];
+      if(a.n_elem != x.n_elem) { a.zeros(x.n_elem); }
+      return a;
+    }
+  };
+
+  // the values of the continuous nodes as one vector
+  class Parameters {
+    std::vector<MCMCObject*> nodes_;
+    size_t size_;
+
+    static double* data(MCMCObject* node) {
+      if(Dynamic<double&>* d = dynamic_cast<Dynamic<double&>*>(node)) { return &d->value; }
+      if(Dynamic<arma::vec&>* v = dynamic_cast<Dynamic<arma::vec&>*>(node)) { return v->value.memptr(); }
+      if(Dynamic<arma::mat&>* m = dynamic_cast<Dynamic<arma::mat&>*>(node)) { return m->value.memptr(); }
+      return nullptr;
+    }
+  public:
+    Parameters(): size_(0) {}
+
+    void add(MCMCObject* node) {
+      if(data(node) == nullptr) {
+        throw std::logic_error("ERROR: hamiltonian sampling needs double, vec or mat nodes.");
+      }
+      nodes_.push_back(node);
+      size_ += node->size();
+    }
+
+    size_t size() const { return size_; }
+
+    void get(arma::vec& theta) const {
+      theta.set_size(size_);
+      size_t k(0);
+      for(auto node : nodes_) {
+        const double* p = data(node);
+        for(size_t i = 0; i < node->size(); i++) { theta[k++] = p[i]; }
+      }
+    }
+
+    void set(const arma::vec& theta) const {
+      size_t k(0);
+      for(auto node : nodes_) {
+        double* p = data(node);
+        for(size_t i = 0; i < node->size(); i++) { p[i] = theta[k++]; }
+      }
+    }
+
+    void gradient(Adjoints& adj, arma::vec& grad) const {
+      grad.set_size(size_);
+      size_t k(0);
+      for(auto node : nodes_) {
+        if(Dynamic<double&>* d = dynamic_cast<Dynamic<double&>*>(node)) {
+          grad[k++] = adj(d->value);
+        } else {
+          Dynamic<arma::mat&>* m = dynamic_cast<Dynamic<arma::mat&>*>(node);
+          const arma::vec& a = m ? adj(m->value) : adj(dynamic_cast<Dynamic<arma::vec&>*>(node)->value);
+          for(size_t i = 0; i < a.n_elem; i++) { grad[k++] = a[i]; }
+        }
+      }
+    }
+  };
+
+  // integer arguments are converted before dividing by the probabilities
+  inline double to_double(const double x) { return x; }
+  inline double to_double(const int x) { return x; }
+
+  template<typename T>
+  arma::mat to_double(const T& x) { return arma::conv_to<arma::mat>::from(x); }
+
+} // namespace cppbugs
+#endif // MCMC_GRADIENT_HPP
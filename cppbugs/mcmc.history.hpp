@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_HISTORY_HPP
+#define MCMC_HISTORY_HPP
+
+#include <vector>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <armadillo>
+
+namespace cppbugs {
+
+  // views of one stored draw, using the memory of the history
+  template<typename eT>
+  const arma::Col<eT> history_view(const arma::Col<eT>*, const eT* p, const size_t n_rows, const size_t) {
+    return arma::Col<eT>(const_cast<eT*>(p), n_rows, false, true);
+  }
+
+  template<typename eT>
+  const arma::Mat<eT> history_view(const arma::Mat<eT>*, const eT* p, const size_t n_rows, const size_t n_cols) {
+    return arma::Mat<eT>(const_cast<eT*>(p), n_rows, n_cols, false, true);
+  }
+
+  // the draws of a node, stored contiguously
+  template<typename T, bool = std::is_arithmetic<T>::value>
+  class History;
+
+  // scalars: a plain vector, matrix() is 1 x draws
+  template<typename T>
+  class History<T, true> {
+    std::vector<T> data_;
+  public:
+    typedef T value_type;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    History(const T&) {}
+    size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+    void clear() { data_.clear(); }
+    void reserve(const size_t n) { data_.reserve(n); }
+    void push_back(const T x) { data_.push_back(x); }
+    void append(const History& other) { data_.insert(data_.end(), other.data_.begin(), other.data_.end()); }
+    const T& operator[](const size_t i) const { return data_[i]; }
+    const_iterator begin() const { return data_.begin(); }
+    const_iterator end() const { return data_.end(); }
+    const arma::Mat<T> matrix() const {
+      return arma::Mat<T>(const_cast<T*>(data_.data()), 1, data_.size(), false, true);
+    }
+  };
+
+  // armadillo objects: one column of an elements x capacity matrix per draw
+  template<typename T>
+  class History<T, false> {
+  public:
+    typedef typename T::elem_type elem_type;
+    typedef T value_type;
+  private:
+    arma::Mat<elem_type> data_;
+    size_t size_, n_rows_, n_cols_;
+
+    // the shape is that of the first draw, as a node may be sized after it is tracked
+    void shape(const size_t n_rows, const size_t n_cols) {
+      if(size_ == 0) {
+        if(n_rows * n_cols != n_rows_ * n_cols_) {
+          arma::Mat<elem_type> data(n_rows * n_cols, data_.n_cols);
+          data_.swap(data);
+        }
+        n_rows_ = n_rows;
+        n_cols_ = n_cols;
+      } else if(n_rows != n_rows_ || n_cols != n_cols_) {
+        throw std::logic_error("ERROR: the size of a node changed between draws.");
+      }
+    }
+
+    void grow(const size_t capacity) {
+      arma::Mat<elem_type> data(n_rows_ * n_cols_, capacity);
+      if(size_) {
+        std::memcpy(data.memptr(), data_.memptr(), size_ * n_rows_ * n_cols_ * sizeof(elem_type));
+      }
+      data_.swap(data);
+    }
+  public:
+    class const_iterator {
+      const History* h_;
+      size_t i_;
+    public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const T* pointer;
+      typedef const T reference;
+
+      const_iterator(const History* h, const size_t i): h_(h), i_(i) {}
+      const T operator*() const { return (*h_)[i_]; }
+      const_iterator& operator++() { ++i_; return *this; }
+      const_iterator operator++(int) { const_iterator ans(*this); ++i_; return ans; }
+      const_iterator& operator+=(const std::ptrdiff_t n) { i_ += n; return *this; }
+      const_iterator operator+(const std::ptrdiff_t n) const { return const_iterator(h_, i_ + n); }
+      std::ptrdiff_t operator-(const const_iterator& other) const { return i_ - other.i_; }
+      bool operator==(const const_iterator& other) const { return i_ == other.i_; }
+      bool operator!=(const const_iterator& other) const { return i_ != other.i_; }
+    };
+
+    History(const T& shape): size_(0), n_rows_(shape.n_rows), n_cols_(shape.n_cols) {}
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { size_ = 0; }
+    void reserve(const size_t n) {
+      if(n > data_.n_cols) { grow(n); }
+    }
+    void push_back(const T& x) {
+      shape(x.n_rows, x.n_cols);
+      if(size_ == data_.n_cols) {
+        grow(std::max<size_t>(16, 2 * size_));
+      }
+      std::memcpy(data_.colptr(size_++), x.memptr(), n_rows_ * n_cols_ * sizeof(elem_type));
+    }
+    void append(const History& other) {
+      if(other.size_) { shape(other.n_rows_, other.n_cols_); }
+      reserve(size_ + other.size_);
+      if(other.size_) {
+        std::memcpy(data_.colptr(size_), other.data_.memptr(), other.size_ * n_rows_ * n_cols_ * sizeof(elem_type));
+      }
+      size_ += other.size_;
+    }
+    const T operator[](const size_t i) const {
+      return history_view(static_cast<const T*>(nullptr), data_.colptr(i), n_rows_, n_cols_);
+    }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+    // elements x draws, using the memory of the history
+    const arma::Mat<elem_type> matrix() const {
+      return arma::Mat<elem_type>(const_cast<elem_type*>(data_.memptr()), n_rows_ * n_cols_, size_, false, true);
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_HISTORY_HPP
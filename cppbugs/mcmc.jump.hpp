@@ -15,6 +15,8 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>. //
 ///////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cmath>
 #include <cppbugs/mcmc.rng.base.hpp>
 
 #ifndef MCMC_JUMP_HPP
@@ -22,23 +24,66 @@
 
 namespace cppbugs {
 
+  // R is RngBase, or the concrete generator so that the draws inline
+
   // needed for completeness
-  void jump_impl(RngBase& rng, int& value, const double scale) {
+  template<typename R>
+  void jump_impl(R& rng, int& value, const double scale) {
     value += lrint(rng.normal() * scale);
   }
 
-  void jump_impl(RngBase& rng, double& value, const double scale) {
+  template<typename R>
+  void jump_impl(R& rng, double& value, const double scale) {
     value += rng.normal() * scale;
   }
 
-  void jump_impl(RngBase& rng, float& value, const double scale) {
+  template<typename R>
+  void jump_impl(R& rng, float& value, const double scale) {
     value += rng.normal() * scale;
   }
 
-  template<typename T>
-  void jump_impl(RngBase& rng, T& value, const double scale) {
-    for(size_t i = 0; i < value.n_elem; i++) {
-      jump_impl(rng, value[i], scale);
+  // arma types draw their jumps by blocks through the bulk generator
+  const size_t jump_block_size = 256;
+
+  inline void add_jump(int& value, const double jump) { value += lrint(jump); }
+  inline void add_jump(double& value, const double jump) { value += jump; }
+  inline void add_jump(float& value, const double jump) { value += jump; }
+
+  template<typename R, typename T>
+  void jump_impl(R& rng, T& value, const double scale) {
+    double z[jump_block_size];
+    for(size_t first = 0; first < value.n_elem; first += jump_block_size) {
+      const size_t n = std::min<size_t>(jump_block_size, value.n_elem - first);
+      rng.normal(z, n);
+      for(size_t i = 0; i < n; i++) {
+        add_jump(value[first + i], z[i] * scale);
+      }
+    }
+  }
+
+  // value = old_value + jump, in one pass
+  template<typename R>
+  void jump_impl(R& rng, int& value, const int old_value, const double scale) {
+    value = old_value;
+    jump_impl(rng, value, scale);
+  }
+
+  template<typename R>
+  void jump_impl(R& rng, double& value, const double old_value, const double scale) {
+    value = old_value;
+    jump_impl(rng, value, scale);
+  }
+
+  template<typename R, typename T>
+  void jump_impl(R& rng, T& value, const T& old_value, const double scale) {
+    double z[jump_block_size];
+    for(size_t first = 0; first < value.n_elem; first += jump_block_size) {
+      const size_t n = std::min<size_t>(jump_block_size, value.n_elem - first);
+      rng.normal(z, n);
+      for(size_t i = 0; i < n; i++) {
+        value[first + i] = old_value[first + i];
+        add_jump(value[first + i], z[i] * scale);
+      }
     }
   }
 
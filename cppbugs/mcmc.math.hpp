@@ -20,7 +20,10 @@
 
 #include <stdexcept>
 #include <cmath>
+#include <type_traits>
 #include <armadillo>
+#include <cppbugs/mcmc.simd.hpp>
+#include <cppbugs/mcmc.factln.hpp>
 
 namespace cppbugs {
 
@@ -40,14 +43,20 @@ namespace cppbugs {
       + (addcst + 0.69314718055995f*exp);
   }
 
+  // doubles use the double precision kernels
   inline double log_approx(const double x) {
-    return log_approx((float)x);
+    return simd::log(x);
   }
 
   inline float log_approx(const int x) {
     return log_approx((float)x);
   }
 
+  // range of log_approx(x) - log(x) over positive floats, with some margin
+  // the double kernels are well within it
+  const double log_approx_error_above = 1.5e-4;
+  const double log_approx_error_below = -1.1e-4;
+
   // We do not inline these constants, because that makes GCC
   // not able to recognize max/min pattern, and then the code is
   // not vectorized.
@@ -68,6 +77,26 @@ namespace cppbugs {
     float ret = xu.f * (0.51079604f+b*(0.30980503f+b*(0.16876894f+b*(-0.00303925f+b*0.01367652f))));
     return ret;
   }
+
+  inline double exp_approx(const double x) {
+    return simd::exp(x);
+  }
+
+  inline double log1p_approx(const double x) {
+    return simd::log1p(x);
+  }
+
+  inline double lgamma(const double x) {
+    return simd::lgamma(x);
+  }
+
+  // evaluates a double expression, then applies f to all its elements at once
+  template<typename T1>
+  arma::Mat<double> bulk_eval(const arma::Base<double,T1>& A, void (*f)(const double*, double*, size_t)) {
+    arma::Mat<double> ans(A.get_ref());
+    f(ans.memptr(), ans.memptr(), ans.n_elem);
+    return ans;
+  }
 }
 
 namespace arma {
@@ -82,11 +111,18 @@ namespace arma {
   // Base
   template<typename T1>
   arma_inline
-  const eOp<T1, eop_log_approx> log_approx(const Base<typename T1::elem_type,T1>& A) {
+  typename std::enable_if<!std::is_same<typename T1::elem_type,double>::value, const eOp<T1, eop_log_approx> >::type
+  log_approx(const Base<typename T1::elem_type,T1>& A) {
     arma_extra_debug_sigprint();
     return eOp<T1, eop_log_approx>(A.get_ref());
   }
 
+  template<typename T1>
+  inline
+  Mat<double> log_approx(const Base<double,T1>& A) {
+    return cppbugs::bulk_eval(A, cppbugs::simd::log);
+  }
+
   // BaseCube
   template<typename T1>
   arma_inline
@@ -108,11 +144,18 @@ namespace arma {
   // Base
   template<typename T1>
   arma_inline
-  const eOp<T1, eop_exp_approx> exp_approx(const Base<typename T1::elem_type,T1>& A) {
+  typename std::enable_if<!std::is_same<typename T1::elem_type,double>::value, const eOp<T1, eop_exp_approx> >::type
+  exp_approx(const Base<typename T1::elem_type,T1>& A) {
     arma_extra_debug_sigprint();
     return eOp<T1, eop_exp_approx>(A.get_ref());
   }
 
+  template<typename T1>
+  inline
+  Mat<double> exp_approx(const Base<double,T1>& A) {
+    return cppbugs::bulk_eval(A, cppbugs::simd::exp);
+  }
+
   // BaseCube
   template<typename T1>
   arma_inline
@@ -122,23 +165,61 @@ namespace arma {
   }
 }
 
+namespace arma {
+  // single precision log_approx and exp_approx, whatever the element type
+  class eop_log_fast : public eop_core<eop_log_fast> {};
+
+  template<> template<typename eT> arma_hot arma_pure arma_inline eT
+  eop_core<eop_log_fast>::process(const eT val, const eT  ) {
+    return cppbugs::log_approx(float(val));
+  }
+
+  template<typename T1>
+  arma_inline
+  const eOp<T1, eop_log_fast> log_fast(const Base<typename T1::elem_type,T1>& A) {
+    arma_extra_debug_sigprint();
+    return eOp<T1, eop_log_fast>(A.get_ref());
+  }
+
+  class eop_exp_fast : public eop_core<eop_exp_fast> {};
+
+  template<> template<typename eT> arma_hot arma_pure arma_inline eT
+  eop_core<eop_exp_fast>::process(const eT val, const eT  ) {
+    return cppbugs::exp_approx(float(val));
+  }
+
+  template<typename T1>
+  arma_inline
+  const eOp<T1, eop_exp_fast> exp_fast(const Base<typename T1::elem_type,T1>& A) {
+    arma_extra_debug_sigprint();
+    return eOp<T1, eop_exp_fast>(A.get_ref());
+  }
+}
+
 namespace arma {
   // lgamma
   class eop_lgamma : public eop_core<eop_lgamma> {};
 
   template<> template<typename eT> arma_hot arma_pure arma_inline eT
   eop_core<eop_lgamma>::process(const eT val, const eT  ) {
-    return lgamma(val);
+    return cppbugs::simd::lgamma(val);
   }
 
   // Base
   template<typename T1>
   arma_inline
-  const eOp<T1, eop_lgamma> lgamma(const Base<typename T1::elem_type,T1>& A) {
+  typename std::enable_if<!std::is_same<typename T1::elem_type,double>::value, const eOp<T1, eop_lgamma> >::type
+  lgamma(const Base<typename T1::elem_type,T1>& A) {
     arma_extra_debug_sigprint();
     return eOp<T1, eop_lgamma>(A.get_ref());
   }
 
+  template<typename T1>
+  inline
+  Mat<double> lgamma(const Base<double,T1>& A) {
+    return cppbugs::bulk_eval(A, cppbugs::simd::lgamma);
+  }
+
   // BaseCube
   template<typename T1>
   arma_inline
@@ -148,43 +229,66 @@ namespace arma {
   }
 }
 
+namespace cppbugs {
+  // recurrence up to x >= 6, then the asymptotic series
+  inline double digamma(double x) {
+    double ans(0);
+    for(; x < 6; x += 1) {
+      ans -= 1/x;
+    }
+    const double f = 1/(x*x);
+    return ans + log(x) - 0.5/x
+      - f*(1.0/12 - f*(1.0/120 - f*(1.0/252 - f*(1.0/240 - f/132))));
+  }
+}
 
 namespace arma {
-  // factln
-  double factln(const int i) {
-    static std::vector<double> factln_table;
+  // digamma
+  class eop_digamma : public eop_core<eop_digamma> {};
 
-    if(i < 0) {
-      return -std::numeric_limits<double>::infinity();
-    }
+  template<> template<typename eT> arma_hot arma_pure arma_inline eT
+  eop_core<eop_digamma>::process(const eT val, const eT  ) {
+    return cppbugs::digamma(val);
+  }
 
-    if(i > 100) {
-      return ::lgamma(double(i) + 1);
-    }
+  // Base
+  template<typename T1>
+  arma_inline
+  const eOp<T1, eop_digamma> digamma(const Base<typename T1::elem_type,T1>& A) {
+    arma_extra_debug_sigprint();
+    return eOp<T1, eop_digamma>(A.get_ref());
+  }
+}
 
-    if(factln_table.size() < static_cast<size_t>(i+1)) {
-      for(int j = factln_table.size(); j < (i+1); j++) {
-        factln_table.push_back(::lgamma(double(j) + 1));
-      }
-    }
-    return factln_table[i];
+
+namespace arma {
+  // factln
+  inline double factln(const int i) {
+    return cppbugs::simd::factln(double(i));
   }
 
   class eop_factln : public eop_core<eop_factln> {};
 
   template<> template<typename eT> arma_hot arma_pure arma_inline eT
   eop_core<eop_factln>::process(const eT val, const eT  ) {
-    return factln(val);
+    return cppbugs::simd::factln(double(val));
   }
 
   // Base
   template<typename T1>
   arma_inline
-  const eOp<T1, eop_factln> factln(const Base<typename T1::elem_type,T1>& A) {
+  typename std::enable_if<!std::is_same<typename T1::elem_type,double>::value, const eOp<T1, eop_factln> >::type
+  factln(const Base<typename T1::elem_type,T1>& A) {
     arma_extra_debug_sigprint();
     return eOp<T1, eop_factln>(A.get_ref());
   }
 
+  template<typename T1>
+  inline
+  Mat<double> factln(const Base<double,T1>& A) {
+    return cppbugs::bulk_eval(A, cppbugs::simd::factln);
+  }
+
   // BaseCube
   template<typename T1>
   arma_inline
@@ -255,6 +359,54 @@ namespace cppbugs {
     return x.n_elem;
   }
 
+  // likelihoods of column vectors can be evaluated by chunks of elements,
+  // scalar arguments being broadcast to every chunk
+  inline bool chunkable(const double) { return true; }
+  inline bool chunkable(const int) { return true; }
+  template<typename T> bool chunkable(const arma::Col<T>&) { return true; }
+  template<typename T> bool chunkable(const T&) { return false; }
+
+  // elements [first, last) of x
+  template<typename T>
+  const T& chunk(const T& x, const size_t, const size_t) { return x; }
+
+  template<typename T>
+  auto chunk(const arma::Col<T>& x, const size_t first, const size_t last) -> decltype(x.subvec(first, last)) {
+    return x.subvec(first, last - 1);
+  }
+
+  // the likelihoods of observed data reduce to sufficient statistics when the
+  // hyperparameters are scalars, or constants (held by value or const reference)
+  template<typename T>
+  struct is_scalar_arg : std::is_arithmetic<typename std::decay<T>::type> {};
+
+  // armadillo expressions held by value (X*b, y - mu) keep references to their
+  // operands, so unlike matrices held by value they may depend on any node
+  template<typename T, typename = void>
+  struct is_arma_expression : std::false_type {};
+
+  template<typename T>
+  struct is_arma_expression<T, typename std::enable_if<!std::is_base_of<arma::Mat<typename T::elem_type>, T>::value>::type> : std::true_type {};
+
+  template<typename T>
+  struct is_constant_arg : std::integral_constant<bool, (!std::is_reference<T>::value && !is_arma_expression<T>::value) ||
+                                                  std::is_const<typename std::remove_reference<T>::type>::value> {};
+
+  // x as a concrete matrix, for code which needs memptr() or x[i]; expressions
+  // are evaluated, matrices are passed through without a copy
+  template<typename T>
+  typename std::enable_if<!is_arma_expression<T>::value, const T&>::type
+  materialize(const T& x) { return x; }
+
+  template<typename T>
+  typename std::enable_if<is_arma_expression<T>::value, arma::Mat<typename T::elem_type> >::type
+  materialize(const T& x) { return x; }
+
+  // element i of x, scalars being broadcast
+  inline double broadcast_at(const double x, const size_t) { return x; }
+  inline double broadcast_at(const int x, const size_t) { return x; }
+  template<typename T> double broadcast_at(const T& x, const size_t i) { return x[i]; }
+
   static inline double square(double x) {
     return x*x;
   }
@@ -277,77 +429,169 @@ namespace cppbugs {
     return arma::as_scalar(err * sigma.i() * err.t());
   }
 
-  template<typename T, typename U, typename V>
+  // rank-one update of a lower cholesky factor: L*L.t() + v*v.t()
+  // v is used as scratch space
+  void chol_update(arma::mat& L, arma::vec& v) {
+    for(size_t k = 0; k < v.n_elem; k++) {
+      const double r = std::sqrt(L(k,k) * L(k,k) + v[k] * v[k]);
+      const double c = r / L(k,k);
+      const double s = v[k] / L(k,k);
+      L(k,k) = r;
+      for(size_t i = k + 1; i < v.n_elem; i++) {
+        L(i,k) = (L(i,k) + s * v[i]) / c;
+        v[i] = c * v[i] - s * L(i,k);
+      }
+    }
+  }
+
+  // math policies: the kernels used by the log-densities, chosen at compile
+  // time through the M parameter of the likelihoods and of MCModel
+
+  // double precision kernels everywhere (the default)
+  struct ExactMath {
+    static double log(const double x) { return simd::log(x); }
+    static double exp(const double x) { return simd::exp(x); }
+    static double lgamma(const double x) { return simd::lgamma(x); }
+    template<typename T1>
+    static auto log(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(arma::log_approx(A)) { return arma::log_approx(A); }
+    template<typename T1>
+    static auto exp(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(arma::exp_approx(A)) { return arma::exp_approx(A); }
+    template<typename T1>
+    static auto lgamma(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(arma::lgamma(A)) { return arma::lgamma(A); }
+  };
+
+  // the single precision approximations, relative error around 1e-4
+  struct FastMath {
+    static double log(const double x) { return log_approx(float(x)); }
+    static double exp(const double x) { return exp_approx(float(x)); }
+    static double lgamma(const double x) { return simd::lgamma(x); }
+    template<typename T1>
+    static auto log(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(arma::log_fast(A)) { return arma::log_fast(A); }
+    template<typename T1>
+    static auto exp(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(arma::exp_fast(A)) { return arma::exp_fast(A); }
+    template<typename T1>
+    static auto lgamma(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(arma::lgamma(A)) { return arma::lgamma(A); }
+  };
+
+  // exact for scalars, which are broadcast over the data and where the
+  // error of the approximation would add up, fast for element-wise terms
+  struct MixedMath {
+    static double log(const double x) { return ExactMath::log(x); }
+    static double exp(const double x) { return ExactMath::exp(x); }
+    static double lgamma(const double x) { return ExactMath::lgamma(x); }
+    template<typename T1>
+    static auto log(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(FastMath::log(A)) { return FastMath::log(A); }
+    template<typename T1>
+    static auto exp(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(FastMath::exp(A)) { return FastMath::exp(A); }
+    template<typename T1>
+    static auto lgamma(const arma::Base<typename T1::elem_type,T1>& A) -> decltype(FastMath::lgamma(A)) { return FastMath::lgamma(A); }
+  };
+
+  template<typename M = ExactMath, typename T, typename U, typename V>
   double normal_logp(const T& x, const U& mu, const V& tau) {
-    return arma::accu(0.5f*log_approx(0.5f*tau/arma::math::pi())
+    return arma::accu(0.5f*M::log(0.5f*tau/arma::math::pi())
                       - 0.5f * schur_product(tau, square(x - mu)));
   }
 
-  template<typename T, typename U, typename V>
+  template<typename M = ExactMath, typename T, typename U, typename V>
   double uniform_logp(const T& x, const U& lower, const V& upper) {
     if(!arma::all(x > lower) || !arma::all(x < upper))
       return -std::numeric_limits<double>::infinity();
-    return -arma::accu(log_approx(upper - lower));
+    return -arma::accu(M::log(upper - lower));
   }
 
-  template<typename T, typename U, typename V>
+  template<typename M = ExactMath, typename T, typename U, typename V>
   double gamma_logp(const T& x, const U& alpha, const V& beta) {
     if(!arma::all(x > 0))
       return -std::numeric_limits<double>::infinity();
     return
-      arma::accu(schur_product((alpha - 1.0f),log_approx(x))
-                 - schur_product(beta,x) - lgamma(alpha)
-                 + schur_product(alpha,log_approx(beta)));
+      arma::accu(schur_product((alpha - 1.0f),M::log(x))
+                 - schur_product(beta,x) - M::lgamma(alpha)
+                 + schur_product(alpha,M::log(beta)));
   }
 
-  template<typename T, typename U, typename V>
+  template<typename M = ExactMath, typename T, typename U, typename V>
   double beta_logp(const T& x, const U& alpha, const V& beta) {
     if(!arma::all(x > 0) || !arma::all(x < 1) ||
        !arma::all(alpha > 0) || !arma::all(beta > 0))
       return -std::numeric_limits<double>::infinity();
-    return arma::accu(lgamma(alpha+beta) - lgamma(alpha) - lgamma(beta)
-                      + schur_product(alpha - 1.0f, log_approx(x))
-                      + schur_product(beta - 1.0f, log_approx(1.0f - x)));
+    return arma::accu(M::lgamma(alpha+beta) - M::lgamma(alpha) - M::lgamma(beta)
+                      + schur_product(alpha - 1.0f, M::log(x))
+                      + schur_product(beta - 1.0f, M::log(1.0f - x)));
   }
 
-  template<typename T, typename U, typename V>
+  template<typename M = ExactMath, typename T, typename U, typename V>
   double binom_logp(const T& x, const U& n, const V& p) {
     if(!arma::all(x >= 0) || !arma::all(x <= n))
       return -std::numeric_limits<double>::infinity();
-    return arma::accu(schur_product(x,log_approx(p))
-                      + schur_product((n-x),log_approx(1-p)) + arma::factln(n) - arma::factln(x) - arma::factln(n-x));
+    return arma::accu(schur_product(x,M::log(p))
+                      + schur_product((n-x),M::log(1-p)) + arma::factln(n) - arma::factln(x) - arma::factln(n-x));
   }
 
-  template<typename T, typename U>
+  template<typename M = ExactMath, typename T, typename U>
   double bernoulli_logp(const T& x, const U& p) {
     if(!arma::all(x >= 0) || !arma::all(x <= 1))
       return -std::numeric_limits<double>::infinity();
-    return arma::accu(schur_product(x,log_approx(p))
-                      + schur_product((1-x), log_approx(1-p)));
+    return arma::accu(schur_product(x,M::log(p))
+                      + schur_product((1-x), M::log(1-p)));
   }
 
-  // sigma denotes cov matrix rather than precision matrix
-  double multivariate_normal_sigma_logp(const arma::rowvec& x, const arma::rowvec& mu, const arma::mat& sigma) {
+  // log density of x given the upper cholesky factor R of sigma (R.t()*R = sigma),
+  // or of the precision matrix when precision is set, in O(d^2): the
+  // log-determinant is read off the diagonal of R and the quadratic form
+  // is a triangular solve, or a triangular product for a precision matrix
+  template<typename M = ExactMath, typename T, typename U>
+  double multivariate_normal_chol_logp(const T& x, const U& mu, const arma::mat& R, const bool precision) {
     const double log_2pi = log(2 * arma::math::pi());
-    arma::mat R(arma::zeros<arma::mat>(sigma.n_cols,sigma.n_cols));
+    const size_t d = R.n_rows;
+    double log_det(0), quad(0);
+    for(size_t i = 0; i < d; i++) {
+      log_det += M::log(R(i,i));
+    }
+    arma::vec z(arma::zeros<arma::vec>(d));
+    if(precision) {
+      // z = R * (x - mu), by columns of R
+      for(size_t k = 0; k < d; k++) {
+        const double err = x[k] - mu[k];
+        const double* r = R.colptr(k);
+        for(size_t i = 0; i <= k; i++) {
+          z[i] += r[i] * err;
+        }
+      }
+      log_det = -log_det;
+    } else {
+      // R.t() * z = x - mu, by forward substitution
+      for(size_t i = 0; i < d; i++) {
+        const double* r = R.colptr(i);
+        double s = x[i] - mu[i];
+        for(size_t k = 0; k < i; k++) {
+          s -= r[k] * z[k];
+        }
+        z[i] = s / r[i];
+      }
+    }
+    for(size_t i = 0; i < d; i++) {
+      quad += z[i] * z[i];
+    }
+    return -(d * log_2pi + 2 * log_det + quad)/2;
+  }
 
+  // sigma denotes cov matrix rather than precision matrix
+  template<typename M = ExactMath>
+  double multivariate_normal_sigma_logp(const arma::rowvec& x, const arma::rowvec& mu, const arma::mat& sigma) {
+    arma::mat R;
     // non-positive definite test via chol
     if(chol(R,sigma) == false) { return -std::numeric_limits<double>::infinity(); }
-
-    // otherwise calc logp
-    return -(x.n_elem * log_2pi + log_approx(arma::det(sigma)) + mahalanobis(x,mu,sigma))/2;
+    return multivariate_normal_chol_logp<M>(x,mu,R,false);
   }
 
   // sigma denotes cov matrix rather than precision matrix
+  template<typename M = ExactMath>
   double multivariate_normal_sigma_logp(const arma::vec& x, const arma::vec& mu, const arma::mat& sigma) {
-    const double log_2pi = log(2 * arma::math::pi());
-    arma::mat R(arma::zeros<arma::mat>(sigma.n_cols,sigma.n_cols));
-
+    arma::mat R;
     // non-positive definite test via chol
     if(chol(R,sigma) == false) { return -std::numeric_limits<double>::infinity(); }
-
-    // otherwise calc logp
-    return -(x.n_elem * log_2pi + log_approx(arma::det(sigma)) + mahalanobis(x,mu,sigma))/2;
+    return multivariate_normal_chol_logp<M>(x,mu,R,false);
   }
 
   template<typename T, typename U, typename V>
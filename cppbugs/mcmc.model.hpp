@@ -21,37 +21,544 @@
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <map>
+#include <set>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <sstream>
 #include <exception>
 #include <cppbugs/mcmc.rng.hpp>
 #include <cppbugs/mcmc.object.hpp>
 #include <cppbugs/mcmc.stochastic.hpp>
+#include <cppbugs/mcmc.dynamic.hpp>
+#include <cppbugs/mcmc.dynamic.stochastic.hpp>
+#include <cppbugs/mcmc.conjugate.hpp>
+#include <cppbugs/mcmc.gradient.hpp>
+#include <cppbugs/mcmc.nuts.hpp>
+#include <cppbugs/mcmc.thread.pool.hpp>
+#include <cppbugs/mcmc.checkpoint.hpp>
+#include <cppbugs/mcmc.serialize.hpp>
 
 namespace cppbugs {
   typedef std::map<void*,MCMCObject*> vmc_map;
 
-  template<class RNG>
+  template<typename X> struct void_if { typedef void type; };
+
+  // the node created by track<MCTYPE>(x): distributions take the math policy
+  // of the model as their second parameter, other nodes have only one
+  template<template<typename...> class MCTYPE, typename T, typename M, typename = void>
+  struct tracked_node { typedef MCTYPE<T> type; };
+
+  template<template<typename...> class MCTYPE, typename T, typename M>
+  struct tracked_node<MCTYPE, T, M, typename void_if<MCTYPE<T, M> >::type> { typedef MCTYPE<T, M> type; };
+
+  template<typename P> struct member_class;
+  template<typename F, typename C> struct member_class<F C::*> { typedef C type; };
+
+  // true if NODE has jump_with<R> from the same class as jump(), so calling
+  // it directly does what the virtual jump() would do
+  template<typename NODE, typename R>
+  class has_jump_with {
+    template<typename U>
+    static std::is_same<typename member_class<decltype(&U::jump)>::type,
+                        typename member_class<decltype(&U::template jump_with<R>)>::type> test(int);
+    template<typename U>
+    static std::false_type test(...);
+  public:
+    static const bool value = decltype(test<NODE>(0))::value;
+  };
+
+  template<class RNG, class M = ExactMath>
   class MCModel {
   private:
-    double accepted_,rejected_,logp_value_,old_logp_value_;
+    // nodes proposed together in step()
+    struct Block {
+      std::vector<size_t> nodes;
+      std::vector<size_t> functors;
+      double accepted, rejected, target_ar;
+    };
+
+    double accepted_,rejected_,logp_value_,old_logp_value_,temperature_;
+    bool conjugate_, early_rejection_;
     SpecializedRng<RNG> rng_;
-    std::vector<MCMCObject*> mcmcObjects, jumping_nodes, dynamic_nodes;
+    std::vector<MCMCObject*> mcmcObjects, jumping_nodes, dynamic_nodes, gibbs_nodes;
+    std::vector<GibbsStep*> gibbs_steps;
     std::vector<Likelihiood*> logp_functors;
     std::function<void ()> update;
+    std::function<void (Adjoints&)> backprop_;
+    std::function<double ()> surrogate_;
+    // splits the large likelihoods when set
+    std::unique_ptr<ThreadPool> likelihood_pool_;
+    size_t chunk_size_;
+    std::unique_ptr<CheckpointWriter> checkpoint_writer_;
+    int checkpoint_every_;
     vmc_map data_node_map;
+    // variables computed in update() and the variables they are computed from
+    std::map<const void*, std::vector<const void*> > derived_map;
+    // functors to recompute when jumping_nodes[i] changes
+    std::vector<std::vector<size_t> > node_functors;
+    std::map<const void*, size_t> jumping_index_;
+    // observed and gibbs sampled nodes do not change when jumping_nodes do
+    std::set<const void*> fixed_addresses_;
+    mutable std::vector<double> logp_cache_;
+    std::vector<double> saved_logp_;
+    // upper bounds of the functors, infinite unless early rejection is on
+    std::vector<double> upper_bounds_;
+    // jumping nodes updated by slice sampling instead of jumps
+    std::vector<size_t> slice_nodes_;
+    std::vector<std::vector<const void*> > block_addresses_;
+    std::vector<Block> blocks_;
+    std::vector<MCMCObject*> deterministic_nodes_;
+    // jumps a node with rng_, without going through RngBase when the type of the node is known
+    typedef void (*Jumper)(MCMCObject*, SpecializedRng<RNG>&);
+    std::map<const MCMCObject*, Jumper> static_jumpers_;
+    std::vector<Jumper> jumpers_;
 
-    void jump() { for(auto v : jumping_nodes) { v->jump(rng_); } }
-    void preserve() { for(auto v : dynamic_nodes) { v->preserve(); } }
-    void revert() { for(auto v : dynamic_nodes) { v->revert(); } }
+    template<typename NODE>
+    static void static_jump(MCMCObject* node, SpecializedRng<RNG>& rng) { static_cast<NODE*>(node)->jump_with(rng); }
+    static void virtual_jump(MCMCObject* node, SpecializedRng<RNG>& rng) { node->jump(rng); }
+
+    template<typename NODE>
+    void addJumper(NODE* node, std::true_type) { static_jumpers_[node] = static_jump<NODE>; }
+    template<typename NODE>
+    void addJumper(NODE*, std::false_type) {}
+
+    void jump(const Block& b) { for(auto i : b.nodes) { jumpers_[i](jumping_nodes[i], rng_); } }
+    void adapt() { for(auto v : jumping_nodes) { v->adapt(); } }
+    void preserve(const Block& b) {
+      for(auto i : b.nodes) { jumping_nodes[i]->preserve(); }
+      for(auto v : deterministic_nodes_) { v->preserve(); }
+    }
+    void revert(const Block& b) {
+      for(auto i : b.nodes) { jumping_nodes[i]->revert(); }
+      for(auto v : deterministic_nodes_) { v->revert(); }
+    }
     void set_scale(const double scale) { for(auto v : jumping_nodes) { v->setScale(scale); } }
-    void tally() { for(auto v : dynamic_nodes) { v->tally(); } }
+    static DynamicStochastic<double&>* sliceNode(MCMCObject* node) {
+      DynamicStochastic<double&>* ans = dynamic_cast<DynamicStochastic<double&>*>(node);
+      return ans && ans->getStepMethod() == StepMethod::slice ? ans : nullptr;
+    }
     static bool bad_logp(const double value) { return std::isnan(value) || value == -std::numeric_limits<double>::infinity() ? true : false; }
+
+    // collects the jumping nodes the variable at address depends on
+    // returns false if that is not known, ie the variable is neither a node
+    // nor declared via dependsOn
+    bool resolve(const void* address, std::set<const void*>& visited, std::set<size_t>& ans) const {
+      auto j = jumping_index_.find(address);
+      if(j != jumping_index_.end()) {
+        ans.insert(j->second);
+        return true;
+      }
+      if(fixed_addresses_.count(address)) {
+        return true;
+      }
+      auto d = derived_map.find(address);
+      if(d == derived_map.end()) {
+        return false;
+      }
+      if(!visited.insert(address).second) {
+        return true;
+      }
+      for(auto parent : d->second) {
+        if(!resolve(parent, visited, ans)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void initDependencies() {
+      jumping_index_.clear();
+      fixed_addresses_.clear();
+      jumpers_.clear();
+      for(size_t i = 0; i < jumping_nodes.size(); i++) {
+        jumping_index_[jumping_nodes[i]->address()] = i;
+        auto j = static_jumpers_.find(jumping_nodes[i]);
+        jumpers_.push_back(j == static_jumpers_.end() ? virtual_jump : j->second);
+      }
+      for(auto node : mcmcObjects) {
+        if(node->isObserved()) { fixed_addresses_.insert(node->address()); }
+      }
+      for(auto node : gibbs_nodes) {
+        fixed_addresses_.insert(node->address());
+      }
+
+      slice_nodes_.clear();
+      for(size_t i = 0; i < jumping_nodes.size(); i++) {
+        if(sliceNode(jumping_nodes[i])) { slice_nodes_.push_back(i); }
+      }
+
+      node_functors.assign(jumping_nodes.size(), std::vector<size_t>());
+      for(size_t k = 0; k < logp_functors.size(); k++) {
+        std::set<size_t> nodes;
+        bool known(true);
+        for(auto arg : logp_functors[k]->arguments()) {
+          std::set<const void*> visited;
+          if(!resolve(arg, visited, nodes)) {
+            known = false;
+            break;
+          }
+        }
+        for(size_t i = 0; i < jumping_nodes.size(); i++) {
+          if(!known || nodes.count(i)) { node_functors[i].push_back(k); }
+        }
+      }
+
+      initBlocks();
+
+      initUpperBounds();
+
+      size_t max_functors(0);
+      for(auto& f : node_functors) { max_functors = std::max(max_functors, f.size()); }
+      for(auto& b : blocks_) { max_functors = std::max(max_functors, b.functors.size()); }
+      saved_logp_.resize(max_functors);
+      logp_cache_.resize(logp_functors.size());
+    }
+
+    void initUpperBounds() {
+      upper_bounds_.clear();
+      for(auto f : logp_functors) {
+        upper_bounds_.push_back(early_rejection_ ? f->upper_bound() : std::numeric_limits<double>::infinity());
+      }
+    }
+
+    // the declared blocks, then one block with the remaining jumping nodes
+    // slice sampled nodes are left out
+    void initBlocks() {
+      blocks_.clear();
+      deterministic_nodes_.clear();
+      for(auto node : mcmcObjects) {
+        if(node->isDeterministc()) { deterministic_nodes_.push_back(node); }
+      }
+
+      std::vector<bool> used(jumping_nodes.size(), false);
+      for(auto i : slice_nodes_) { used[i] = true; }
+      for(auto& addresses : block_addresses_) {
+        Block b;
+        for(auto address : addresses) {
+          auto j = jumping_index_.find(address);
+          if(j == jumping_index_.end()) {
+            // gibbs sampled nodes are not jumped
+            if(fixed_addresses_.count(address)) { continue; }
+            throw std::logic_error("ERROR: block member is not a stochastic node.");
+          }
+          if(used[j->second]) {
+            if(sliceNode(jumping_nodes[j->second])) { continue; }
+            throw std::logic_error("ERROR: node declared in more than one block.");
+          }
+          used[j->second] = true;
+          b.nodes.push_back(j->second);
+        }
+        if(b.nodes.size()) { blocks_.push_back(b); }
+      }
+      Block rest;
+      for(size_t i = 0; i < jumping_nodes.size(); i++) {
+        if(!used[i]) { rest.nodes.push_back(i); }
+      }
+      if(rest.nodes.size()) { blocks_.push_back(rest); }
+
+      for(auto& b : blocks_) {
+        std::set<size_t> functors;
+        double size(0);
+        for(auto i : b.nodes) {
+          functors.insert(node_functors[i].begin(), node_functors[i].end());
+          size += jumping_nodes[i]->size();
+        }
+        b.functors.assign(functors.begin(), functors.end());
+        b.accepted = 0;
+        b.rejected = 0;
+        b.target_ar = std::max(1/log2(size + 3), 0.234);
+      }
+    }
+
+    // chunks are summed in order, so the value does not depend on the number of threads
+    double calc(const Likelihiood* f) const {
+      const size_t n = likelihood_pool_ ? f->elements() : 0;
+      if(n < 2 * chunk_size_) {
+        return f->calc();
+      }
+      std::vector<double> chunks((n + chunk_size_ - 1) / chunk_size_);
+      likelihood_pool_->run(chunks.size(), [&](size_t c) {
+          chunks[c] = f->calc_chunk(c * chunk_size_, std::min(n, (c + 1) * chunk_size_));
+        });
+      double ans(0);
+      for(auto v : chunks) {
+        ans += v;
+      }
+      return ans;
+    }
+
+    double cached_logp() const {
+      double ans(0);
+      for(auto v : logp_cache_) {
+        ans += v;
+      }
+      return ans;
+    }
+
+    // logp after some nodes have changed, only recomputing the functors which depend on them
+    // the sum is taken over all functors in order, so the value is the same as logp()
+    double partial_logp(const std::vector<size_t>& functors) {
+      update();
+      for(size_t k = 0; k < functors.size(); k++) {
+        saved_logp_[k] = logp_cache_[functors[k]];
+        logp_cache_[functors[k]] = calc(logp_functors[functors[k]]);
+      }
+      return cached_logp();
+    }
+
+    static unsigned int checkpoint_magic() { return 0x43504232; }
+
+    void checkpoint(const int iteration) {
+      std::ostringstream out;
+      writeState(out, iteration);
+      std::string data(out.str());
+      checkpoint_writer_->write(data);
+    }
+
+    // iterations first+1 ... iterations+burn
+    void run_from(const int first, int iterations, int burn, int thin) {
+      logp_value_ = logp();
+      if(logp_value_==-std::numeric_limits<double>::infinity()) {
+        throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+      }
+
+      if(checkpoint_writer_ && first == 0) {
+        checkpoint(0);
+      }
+      reserve((iterations + burn - std::max(first, burn)) / thin);
+      for(int i = first + 1; i <= (iterations + burn); i++) {
+        step();
+        if(i > burn && (i % thin == 0)) {
+          tally();
+        }
+        if(checkpoint_writer_ && i % checkpoint_every_ == 0) {
+          flush();
+          checkpoint(i);
+        }
+      }
+      flush();
+      if(checkpoint_writer_) { checkpoint_writer_->wait(); }
+    }
+
+    double early_log_u() {
+      return early_rejection_ ? log(rng_.uniform()) : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // as partial_logp, but returns -inf as soon as the value is known to be
+    // below threshold: the unbounded functors are computed first, as they can
+    // be positive by any amount, then the bounded ones until the upper bounds
+    // of those left cannot reach threshold
+    double partial_logp(const std::vector<size_t>& functors, const double threshold) {
+      if(!early_rejection_) {
+        return partial_logp(functors);
+      }
+      update();
+      double ans(cached_logp()), rest(0);
+      for(size_t k = 0; k < functors.size(); k++) {
+        saved_logp_[k] = logp_cache_[functors[k]];
+        ans -= saved_logp_[k];
+        if(!std::isinf(upper_bounds_[functors[k]])) { rest += upper_bounds_[functors[k]]; }
+      }
+      for(auto k : functors) {
+        if(std::isinf(upper_bounds_[k])) { ans += (logp_cache_[k] = calc(logp_functors[k])); }
+      }
+      // ans + rest is now an upper bound of the logp
+      for(auto k : functors) {
+        if(std::isinf(upper_bounds_[k])) { continue; }
+        if(ans + rest < threshold) {
+          return -std::numeric_limits<double>::infinity();
+        }
+        ans += (logp_cache_[k] = calc(logp_functors[k]));
+        rest -= upper_bounds_[k];
+      }
+      return cached_logp();
+    }
+
+    void revert_logp(const std::vector<size_t>& functors) {
+      for(size_t k = 0; k < functors.size(); k++) {
+        logp_cache_[functors[k]] = saved_logp_[k];
+      }
+    }
+
+    // slice sampling update of jumping_nodes[node], returns the new logp
+    // logp_value and the functor cache must be current
+    double slice(const size_t node, const double logp_value) {
+      double& x = sliceNode(jumping_nodes[node])->value;
+      slice_step(rng_, x, jumping_nodes[node]->getScale(), logp_value / temperature_,
+                 [&](const double v) { x = v; return partial_logp(node_functors[node]) / temperature_; });
+      return cached_logp();
+    }
+
+    // true if f depends on jumping_nodes[node] only through its argument at address
+    bool only_through(const Likelihiood* f, const void* address, const size_t node) const {
+      for(auto arg : f->arguments()) {
+        if(arg == address) { continue; }
+        std::set<const void*> visited;
+        std::set<size_t> nodes;
+        if(!resolve(arg, visited, nodes) || nodes.count(node)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // returns a gibbs step for jumping_nodes[i] if it is a scalar whose prior is
+    // conjugate to all the likelihoods depending on it, null otherwise
+    GibbsStep* conjugateStep(const size_t i) const {
+      Dynamic<double&>* node = dynamic_cast<Dynamic<double&>*>(jumping_nodes[i]);
+      Stochastic* sp = dynamic_cast<Stochastic*>(jumping_nodes[i]);
+      if(!node || !sp || !sp->getLikelihoodFunctor() || sliceNode(jumping_nodes[i])) {
+        return nullptr;
+      }
+      const void* x = node->address();
+      const Likelihiood* prior = sp->getLikelihoodFunctor();
+      if(!only_through(prior, x, i)) {
+        return nullptr;
+      }
+      std::vector<const Likelihiood*> children;
+      for(auto k : node_functors[i]) {
+        if(logp_functors[k] == prior) { continue; }
+        if(!only_through(logp_functors[k], x, i)) {
+          return nullptr;
+        }
+        children.push_back(logp_functors[k]);
+      }
+      if(children.empty()) {
+        return nullptr;
+      }
+
+      const NormalConjugate* normal_prior = dynamic_cast<const NormalConjugate*>(prior);
+      if(normal_prior && normal_prior->mu_address() != x && normal_prior->tau_address() != x) {
+        std::vector<const NormalConjugate*> c;
+        for(auto f : children) {
+          const NormalConjugate* n = dynamic_cast<const NormalConjugate*>(f);
+          if(!n || n->mu_address() != x || n->tau_address() == x || n->x_address() == x) {
+            return nullptr;
+          }
+          c.push_back(n);
+        }
+        return new NormalMeanStep(node->value, normal_prior, c);
+      }
+
+      const GammaConjugate* gamma_prior = dynamic_cast<const GammaConjugate*>(prior);
+      if(gamma_prior && gamma_prior->alpha_address() != x && gamma_prior->beta_address() != x) {
+        std::vector<const NormalConjugate*> c;
+        for(auto f : children) {
+          const NormalConjugate* n = dynamic_cast<const NormalConjugate*>(f);
+          if(!n || n->tau_address() != x || n->mu_address() == x || n->x_address() == x) {
+            return nullptr;
+          }
+          c.push_back(n);
+        }
+        return new GammaPrecisionStep(node->value, gamma_prior, c);
+      }
+
+      const BetaConjugate* beta_prior = dynamic_cast<const BetaConjugate*>(prior);
+      if(beta_prior && beta_prior->alpha_address() != x && beta_prior->beta_address() != x) {
+        std::vector<const BinomialConjugate*> c;
+        for(auto f : children) {
+          const BinomialConjugate* b = dynamic_cast<const BinomialConjugate*>(f);
+          if(!b || b->p_address() != x || b->n_address() == x || b->x_address() == x) {
+            return nullptr;
+          }
+          c.push_back(b);
+        }
+        return new BetaBinomialStep(node->value, beta_prior, c);
+      }
+      return nullptr;
+    }
+
+    // moves the conjugate nodes from jumping_nodes to gibbs_nodes
+    void initConjugates() {
+      std::vector<MCMCObject*> mh_nodes;
+      for(size_t i = 0; i < jumping_nodes.size(); i++) {
+        GibbsStep* g = conjugateStep(i);
+        if(g) {
+          gibbs_steps.push_back(g);
+          gibbs_nodes.push_back(jumping_nodes[i]);
+        } else {
+          mh_nodes.push_back(jumping_nodes[i]);
+        }
+      }
+      if(gibbs_steps.size()) {
+        jumping_nodes = mh_nodes;
+        initDependencies();
+      }
+    }
+
+    void clearConjugates() {
+      for(auto g : gibbs_steps) {
+        delete g;
+      }
+      gibbs_steps.clear();
+      gibbs_nodes.clear();
+    }
+
+    // deterministic variables are brought up to date before each draw
+    void gibbs() {
+      for(auto g : gibbs_steps) {
+        update();
+        g->step(rng_);
+      }
+    }
+    // the jumping nodes as hamiltonian parameters, checking that the
+    // gradient of every likelihood can be taken back to them
+    void initGradient(Parameters& params, Adjoints& adj) const {
+      for(auto node : jumping_nodes) {
+        params.add(node);
+        adj.track(node->address());
+      }
+      for(auto& d : derived_map) {
+        adj.track(d.first);
+      }
+      for(auto f : logp_functors) {
+        if(!f->gradient(adj)) {
+          throw std::logic_error("ERROR: hamiltonian sampling needs likelihoods with gradients.");
+        }
+        for(auto arg : f->arguments()) {
+          std::set<const void*> visited;
+          std::set<size_t> nodes;
+          if(!arg) {
+            throw std::logic_error("ERROR: hamiltonian sampling needs the expressions given to likelihoods computed in update() and declared with dependsOn.");
+          }
+          if(!resolve(arg, visited, nodes)) {
+            throw std::logic_error("ERROR: hamiltonian sampling needs the variables computed in update() declared with dependsOn.");
+          }
+          if(derived_map.count(arg) && !backprop_) {
+            throw std::logic_error("ERROR: hamiltonian sampling needs setGradient for the variables computed in update().");
+          }
+        }
+      }
+    }
+
+    double logp_gradient(const Parameters& params, Adjoints& adj, const arma::vec& theta, arma::vec& grad) {
+      params.set(theta);
+      const double ans = logp();
+      grad.zeros(theta.n_elem);
+      if(bad_logp(ans)) {
+        return ans;
+      }
+      adj.clear();
+      for(auto f : logp_functors) {
+        f->gradient(adj);
+      }
+      if(backprop_) {
+        backprop_(adj);
+      }
+      params.gradient(adj, grad);
+      return ans;
+    }
   public:
+    typedef RNG rng_type;
+
     MCModel(std::function<void ()> update_, long seed = 42):
       accepted_(0), rejected_(0),
       logp_value_(-std::numeric_limits<double>::infinity()),
       old_logp_value_(-std::numeric_limits<double>::infinity()),
-      rng_(seed), update(update_) {}
+      temperature_(1), conjugate_(false), early_rejection_(false), rng_(seed), update(update_), chunk_size_(1 << 16), checkpoint_every_(0) {}
     ~MCModel() {
       // use data_node_map as delete list
       // only objects allocated by this class are inserted thre
@@ -59,6 +566,7 @@ namespace cppbugs {
       for(auto m : data_node_map) {
         delete m.second;
       }
+      clearConjugates();
     }
 
     void addStochcasticNode(MCMCObject* node) {
@@ -70,6 +578,8 @@ namespace cppbugs {
     void initChain() {
       logp_functors.clear();
       jumping_nodes.clear();
+      dynamic_nodes.clear();
+      clearConjugates();
 
       for(auto node : mcmcObjects) {
         addStochcasticNode(node);
@@ -82,6 +592,29 @@ namespace cppbugs {
           dynamic_nodes.push_back(node);
         }
       }
+      initDependencies();
+      // the full conditionals are only known at temperature 1
+      if(conjugate_ && temperature_ == 1) { initConjugates(); }
+    }
+
+    // for engines with streams: the draws of the model depend only on the
+    // seed and the stream, so models can be run in parallel reproducibly
+    void setRngStream(const uint64_t stream) {
+      rng_.set_stream(stream);
+    }
+
+    // accept/reject swaps the buffers of vector and matrix nodes instead of copying them
+    // update() must then assign every variable it computes in full
+    void setDoubleBuffering(const bool double_buffering) {
+      for(auto node : mcmcObjects) {
+        node->setDoubleBuffered(double_buffering);
+      }
+    }
+
+    // scalar nodes with a conjugate prior are drawn directly from their full conditional
+    // instead of being jumped (off by default, as it changes the draws of a model)
+    void setConjugateSampling(const bool conjugate) {
+      conjugate_ = conjugate;
     }
 
     double acceptance_ratio() const {
@@ -89,14 +622,56 @@ namespace cppbugs {
     }
 
     bool reject(const double value, const double old_logp) {
-      return bad_logp(value) || log(rng_.uniform()) > (value - old_logp) ? true : false;
+      return bad_logp(value) || log(rng_.uniform()) > (value - old_logp) / temperature_ ? true : false;
+    }
+
+    // log_u is nan unless drawn in advance by early_log_u()
+    bool reject(const double value, const double old_logp, const double log_u) {
+      if(std::isnan(log_u)) {
+        return reject(value, old_logp);
+      }
+      return bad_logp(value) || log_u > (value - old_logp) / temperature_ ? true : false;
     }
 
+    // draws the acceptance threshold before computing the logp of a proposal,
+    // and stops the computation once the bounded likelihoods (binomial,
+    // bernoulli, discrete) left cannot bring it above the threshold
+    void setEarlyRejection(const bool early_rejection) {
+      early_rejection_ = early_rejection;
+      initUpperBounds();
+    }
+
+    // samples from the posterior to the power 1/temperature
+    void setTemperature(const double temperature) {
+      temperature_ = temperature;
+    }
+
+    double getTemperature() const {
+      return temperature_;
+    }
+
+    // swaps the values of all nodes with other, a replica of this model
+    void exchange(MCModel& other) {
+      if(mcmcObjects.size() != other.mcmcObjects.size()) {
+        throw std::logic_error("ERROR: cannot exchange the states of different models.");
+      }
+      for(size_t i = 0; i < mcmcObjects.size(); i++) {
+        mcmcObjects[i]->exchange(*other.mcmcObjects[i]);
+      }
+      logp_value_ = logp();
+      other.logp_value_ = other.logp();
+    }
+
+    void tally() { for(auto v : dynamic_nodes) { v->tally(); } }
+    void flush() { for(auto v : dynamic_nodes) { v->flush(); } }
+    void reserve(const size_t draws) { for(auto v : dynamic_nodes) { v->reserve(draws); } }
+
     double logp() const {
       double ans(0);
       update();
-      for(auto f : logp_functors) {
-        ans += f->calc();
+      logp_cache_.resize(logp_functors.size());
+      for(size_t k = 0; k < logp_functors.size(); k++) {
+        ans += (logp_cache_[k] = calc(logp_functors[k]));
       }
       return ans;
     }
@@ -106,24 +681,44 @@ namespace cppbugs {
       rejected_ = 0;
     }
 
-    void tune(int iterations, int tuning_step) {
-      double logp_value,old_logp_value;
-      logp_value  = -std::numeric_limits<double>::infinity();
-      old_logp_value = -std::numeric_limits<double>::infinity();
+    // iterations first+1 ... first+iterations of the per node tuning phase, the
+    // scales are tuned at multiples of tuning_step.  a phase starts at first = 0,
+    // where the first jump is always taken, later rounds (MCTempering) continue
+    // from the current logp
+    void tune(int iterations, int tuning_step, int first = 0) {
+      double old_logp_value;
+
+      if(first == 0) {
+        // fill the per functor cache used by partial_logp
+        logp();
+        logp_value_ = -std::numeric_limits<double>::infinity();
+      }
 
-      for(int i = 1; i <= iterations; i++) {
-	for(auto it : jumping_nodes) {
-          old_logp_value = logp_value;
+      for(int i = first + 1; i <= first + iterations; i++) {
+        if(gibbs_steps.size()) {
+          gibbs();
+          logp_value_ = logp();
+        }
+	for(size_t j = 0; j < jumping_nodes.size(); j++) {
+          MCMCObject* it = jumping_nodes[j];
+          if(sliceNode(it)) {
+            logp_value_ = slice(j, logp_value_);
+            continue;
+          }
+          old_logp_value = logp_value_;
           it->preserve();
           it->jump(rng_);
-          logp_value = logp();
-          if(reject(logp_value, old_logp_value)) {
+          const double log_u = early_log_u();
+          logp_value_ = partial_logp(node_functors[j], old_logp_value + temperature_ * log_u);
+          if(reject(logp_value_, old_logp_value, log_u)) {
             it->revert();
-            logp_value = old_logp_value;
+            revert_logp(node_functors[j]);
+            logp_value_ = old_logp_value;
             it->reject();
           } else {
             it->accept();
           }
+          it->adapt();
 	}
 	if(i % tuning_step == 0) {
           //std::cout << "tuning at step: " << i << std::endl;
@@ -135,20 +730,49 @@ namespace cppbugs {
     }
 
     void step() {
-      old_logp_value_ = logp_value_;
-      preserve();
-      jump();
-      logp_value_ = logp();
-      if(reject(logp_value_, old_logp_value_)) {
-        revert();
-        logp_value_ = old_logp_value_;
-        rejected_ += 1;
-      } else {
-        accepted_ += 1;
+      if(gibbs_steps.size() || slice_nodes_.size()) {
+        gibbs();
+        logp_value_ = logp();
+        for(auto j : slice_nodes_) {
+          logp_value_ = slice(j, logp_value_);
+        }
+      }
+      for(auto& b : blocks_) {
+        old_logp_value_ = logp_value_;
+        double surrogate_diff(0);
+        if(surrogate_) {
+          surrogate_diff = -surrogate_();
+        }
+        preserve(b);
+        jump(b);
+        // delayed acceptance: screen with the surrogate, then correct the
+        // full acceptance by the surrogate ratio
+        if(surrogate_) {
+          surrogate_diff += surrogate_();
+          if(reject(surrogate_diff, 0)) {
+            revert(b);
+            b.rejected += 1;
+            rejected_ += 1;
+            continue;
+          }
+        }
+        const double log_u = early_log_u();
+        logp_value_ = partial_logp(b.functors, old_logp_value_ + surrogate_diff + temperature_ * log_u);
+        if(reject(logp_value_ - surrogate_diff, old_logp_value_, log_u)) {
+          revert(b);
+          revert_logp(b.functors);
+          logp_value_ = old_logp_value_;
+          b.rejected += 1;
+          rejected_ += 1;
+        } else {
+          b.accepted += 1;
+          accepted_ += 1;
+        }
       }
     }
 
-    void tune_global(int iterations, int tuning_step) {
+    // as tune(), for the blocks
+    void tune_global(int iterations, int tuning_step, int first = 0) {
       logp_value_ = logp();
 
       const double thresh = 0.1;
@@ -156,23 +780,21 @@ namespace cppbugs {
       // of the parmaeters to be estimtated, as there is somewhat of a leverage effect
       // via the number of parameters
       const double dilution = 0.10;
-      double total_size = 0;
 
-      for(size_t i = 0; i < dynamic_nodes.size(); i++) {
-        if(dynamic_nodes[i]->isStochastic()) {
-          total_size += dynamic_nodes[i]->size();
-        }
-      }
-      double target_ar = std::max(1/log2(total_size + 3), 0.234);
-      for(int i = 1; i <= iterations; i++) {
+      for(int i = first + 1; i <= first + iterations; i++) {
         step();
+        adapt();
         if(i % tuning_step == 0) {
-          double diff = acceptance_ratio() - target_ar;
           resetAcceptanceRatio();
-          if(std::abs(diff) > thresh) {
-            double adj_factor = (1.0 + diff * dilution);
-            for(size_t i = 0; i < dynamic_nodes.size(); i++) {
-              dynamic_nodes[i]->setScale(dynamic_nodes[i]->getScale() * adj_factor);
+          for(auto& b : blocks_) {
+            double diff = b.accepted / (b.accepted + b.rejected) - b.target_ar;
+            b.accepted = 0;
+            b.rejected = 0;
+            if(std::abs(diff) > thresh) {
+              double adj_factor = (1.0 + diff * dilution);
+              for(auto j : b.nodes) {
+                jumping_nodes[j]->setScale(jumping_nodes[j]->getScale() * adj_factor);
+              }
             }
           }
         }
@@ -180,19 +802,79 @@ namespace cppbugs {
     }
 
     void run(int iterations, int burn, int thin) {
-      logp_value_ = logp();
-      if(logp_value_==-std::numeric_limits<double>::infinity()) {
-        throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+      run_from(0, iterations, burn, thin);
+    }
+
+    // iterations counts from the start of the checkpointed run, ie
+    // resume(path, iterations, burn, thin) after sample(iterations, burn, adapt, thin)
+    // only the draws after the checkpoint are in the histories
+    void resume(const std::string& path, int iterations, int burn, int thin) {
+      if(iterations % thin) {
+        throw std::logic_error("ERROR: iterations not a multiple of thin.");
+      }
+      std::ifstream in(path.c_str(), std::ios::binary);
+      if(!in) {
+        throw std::logic_error("ERROR: cannot open checkpoint " + path + ".");
       }
+      initChain();
+      run_from(readState(in), iterations, burn, thin);
+    }
 
-      for(int i = 1; i <= (iterations + burn); i++) {
-        step();
-        if(i > burn && (i % thin == 0)) {
-          tally();
-        }
+    // run() writes the sampler state to path before the first iteration and then
+    // every few iterations, from a background thread.  an empty path turns it off
+    void setCheckpoint(const std::string& path, const int every) {
+      if(every < 1) {
+        throw std::logic_error("ERROR: checkpoint interval must be positive.");
+      }
+      checkpoint_writer_.reset(path.empty() ? nullptr : new CheckpointWriter(path));
+      checkpoint_every_ = every;
+    }
+
+    // the values and tuning of the nodes, the acceptance counters and the rng
+    void writeState(std::ostream& out, const int iteration) const {
+      write_binary(out, checkpoint_magic());
+      write_binary(out, static_cast<unsigned long long>(mcmcObjects.size()));
+      write_binary(out, static_cast<unsigned long long>(blocks_.size()));
+      write_binary(out, iteration);
+      write_binary(out, accepted_);
+      write_binary(out, rejected_);
+      write_binary(out, temperature_);
+      rng_.write(out);
+      for(auto node : mcmcObjects) {
+        node->write(out);
+      }
+      for(auto& b : blocks_) {
+        write_binary(out, b.accepted);
+        write_binary(out, b.rejected);
       }
     }
 
+    // returns the iteration of the checkpoint, initChain() must have been called
+    int readState(std::istream& in) {
+      unsigned int magic;
+      unsigned long long n_nodes, n_blocks;
+      int iteration;
+      read_binary(in, magic);
+      read_binary(in, n_nodes);
+      read_binary(in, n_blocks);
+      if(magic != checkpoint_magic() || n_nodes != mcmcObjects.size() || n_blocks != blocks_.size()) {
+        throw std::logic_error("ERROR: checkpoint does not match the model.");
+      }
+      read_binary(in, iteration);
+      read_binary(in, accepted_);
+      read_binary(in, rejected_);
+      read_binary(in, temperature_);
+      rng_.read(in);
+      for(auto node : mcmcObjects) {
+        node->read(in);
+      }
+      for(auto& b : blocks_) {
+        read_binary(in, b.accepted);
+        read_binary(in, b.rejected);
+      }
+      return iteration;
+    }
+
     void sample(int iterations, int burn, int adapt, int thin) {
       if(iterations % thin) {
         throw std::logic_error("ERROR: iterations not a multiple of thin.");
@@ -213,10 +895,121 @@ namespace cppbugs {
       run(iterations, burn, thin);
     }
 
-    template<template<typename> class MCTYPE, typename T>
-    MCTYPE<T>& track(T&& x) {
-      MCTYPE<T> *node = new MCTYPE<T>(std::forward<T>(x));
+    // no-u-turn hamiltonian sampling of the jumping nodes instead of jumps,
+    // the step size is adapted during the first adapt iterations
+    // the nodes must be double, vec or mat, and conjugate nodes are still drawn by gibbs
+    // acceptance_ratio() reports the mean acceptance statistic of the trajectories
+    void nuts(int iterations, int burn, int adapt, int thin) {
+      if(iterations % thin) {
+        throw std::logic_error("ERROR: iterations not a multiple of thin.");
+      }
+
+      initChain();
+
+      if(logp()==-std::numeric_limits<double>::infinity()) {
+        throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+      }
+
+      Parameters params;
+      Adjoints adj;
+      initGradient(params, adj);
+      NUTS sampler([&](const arma::vec& theta, arma::vec& grad) { return logp_gradient(params, adj, theta, grad); }, rng_);
+      arma::vec theta;
+      params.get(theta);
+      sampler.init(theta);
+
+      reserve(iterations / thin);
+      for(int i = 1; i <= (adapt + iterations + burn); i++) {
+        if(gibbs_steps.size()) {
+          gibbs();
+          sampler.reset(sampler.position());
+        }
+        const double accept_stat = sampler.step();
+        params.set(sampler.position());
+        logp_value_ = logp();
+        if(i <= adapt) {
+          sampler.adapt(accept_stat);
+          if(i == adapt) { sampler.finishAdaptation(); }
+          continue;
+        }
+        accepted_ += accept_stat;
+        rejected_ += 1 - accept_stat;
+        if(i - adapt > burn && ((i - adapt) % thin == 0)) {
+          tally();
+        }
+      }
+      flush();
+    }
+
+    // evaluates the normal, binomial and bernoulli likelihoods of vectors of
+    // more than 2*chunk_size elements by chunks on n_threads threads, 0 turns it off
+    // the result depends on chunk_size but not on n_threads
+    void setLikelihoodThreads(const size_t n_threads, const size_t chunk_size = 1 << 16) {
+      if(chunk_size == 0) {
+        throw std::logic_error("ERROR: chunk size must be positive.");
+      }
+      likelihood_pool_.reset(n_threads ? new ThreadPool(n_threads) : nullptr);
+      chunk_size_ = chunk_size;
+    }
+
+    // surrogate returns a cheap approximation of logp() for the current
+    // values, bringing up to date whatever it reads
+    // step() then only computes logp() for proposals accepted under the surrogate
+    // Christen and Fox, J. Comp. Graph. Stat. 14(4) 2005
+    void setSurrogate(std::function<double ()> surrogate) {
+      surrogate_ = surrogate;
+    }
+
+    // surrogate made of the likelihoods of some of the nodes
+    template<typename... Args>
+    void setSurrogateTerms(const Args&... nodes) {
+      const void* p[] = { (const void*)(&nodes)... };
+      std::vector<Likelihiood*> terms;
+      for(auto address : p) {
+        auto iter = data_node_map.find(const_cast<void*>(address));
+        Stochastic* sp = iter == data_node_map.end() ? nullptr : dynamic_cast<Stochastic*>(iter->second);
+        if(!sp || !sp->getLikelihoodFunctor()) {
+          throw std::logic_error("ERROR: surrogate term is not a stochastic node.");
+        }
+        terms.push_back(sp->getLikelihoodFunctor());
+      }
+      surrogate_ = [this, terms]() {
+        update();
+        double ans(0);
+        for(auto f : terms) { ans += f->calc(); }
+        return ans;
+      };
+    }
+
+    // backprop adds the derivatives of the variables computed in update() to
+    // the variables they are computed from, see Adjoints
+    void setGradient(std::function<void (Adjoints&)> backprop) {
+      backprop_ = backprop;
+    }
+
+    // declares nodes proposed together by step(), with their own scale tuning
+    // undeclared jumping nodes form one more block, so with no blocks step() jumps every node at once
+    template<typename... Args>
+    void block(const Args&... nodes) {
+      const void* p[] = { (const void*)(&nodes)... };
+      block_addresses_.push_back(std::vector<const void*>(p, p + sizeof...(Args)));
+    }
+
+    // declares that x is computed in update() from parents only
+    // lets tune() skip the likelihoods which use x when other nodes jump
+    // variables which are not nodes and not declared here are assumed to depend on every node
+    template<typename T, typename... Args>
+    void dependsOn(const T& x, const Args&... parents) {
+      const void* p[] = { (const void*)(&parents)..., nullptr };
+      derived_map[(const void*)(&x)] = std::vector<const void*>(p, p + sizeof...(Args));
+    }
+
+    template<template<typename...> class MCTYPE, typename T>
+    typename tracked_node<MCTYPE, T, M>::type& track(T&& x) {
+      typedef typename tracked_node<MCTYPE, T, M>::type NODE;
+      NODE *node = new NODE(std::forward<T>(x));
       mcmcObjects.push_back(node);
+      addJumper(node, std::integral_constant<bool, has_jump_with<NODE, SpecializedRng<RNG> >::value>());
       data_node_map[std::is_lvalue_reference<T>::value ? (void*)(&x) : (void*)this] = node;
       return *node;
     }
@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_MULTICHAIN_HPP
+#define MCMC_MULTICHAIN_HPP
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <type_traits>
+#include <cppbugs/mcmc.math.hpp>
+#include <cppbugs/mcmc.thread.pool.hpp>
+
+namespace cppbugs {
+
+  // each chain gets its own rng stream derived from the base seed
+  inline long chain_seed(const long seed, const size_t chain) {
+    std::seed_seq seq{static_cast<unsigned long>(seed), static_cast<unsigned long>(chain)};
+    std::vector<unsigned int> ans(1);
+    seq.generate(ans.begin(), ans.end());
+    return ans[0];
+  }
+
+  // true for engines with streams, such as Philox4x32
+  template<typename RNG>
+  class has_streams {
+    template<typename U>
+    static auto test(int) -> decltype(std::declval<U&>().set_stream(0), std::true_type());
+    template<typename U>
+    static std::false_type test(...);
+  public:
+    static const bool value = decltype(test<RNG>(0))::value;
+  };
+
+  // chains and replicas built from the same seed, on streams 0, 1, ... when
+  // the engine has them, from seeds derived from it otherwise
+  template<typename MODEL>
+  MODEL* make_chain(std::function<MODEL* (long seed)> factory, const long seed, const size_t chain, std::true_type) {
+    MODEL* ans = factory(seed);
+    ans->setRngStream(chain);
+    return ans;
+  }
+
+  template<typename MODEL>
+  MODEL* make_chain(std::function<MODEL* (long seed)> factory, const long seed, const size_t chain, std::false_type) {
+    return factory(chain_seed(seed, chain));
+  }
+
+  template<typename MODEL>
+  MODEL* make_chain(std::function<MODEL* (long seed)> factory, const long seed, const size_t chain) {
+    return make_chain<MODEL>(factory, seed, chain, std::integral_constant<bool, has_streams<typename MODEL::rng_type>::value>());
+  }
+
+  // runs several independent chains of the same model in parallel
+  //
+  // the model state is captured by reference in the update function, so
+  // each chain needs its own copy of it.  MODEL is therefore a class derived
+  // from MCModel<RNG> which owns its variables and adds its nodes in its
+  // constructor, ie:
+  //
+  //   class HerdModel : public MCModel<std::mt19937> {
+  //   public:
+  //     vec b; ...
+  //     HerdModel(long seed): MCModel<std::mt19937>([this]() { ... }, seed), b(randn<vec>(4)) {
+  //       track<Normal>(b).dnorm(0,0.001); ...
+  //     }
+  //   };
+  //
+  //   MCMultiChain<HerdModel> chains(4);
+  //   chains.sample(1e6,1e5,1e4,50);
+  //   chains.mean(&HerdModel::b);
+  template<class MODEL>
+  class MCMultiChain {
+  public:
+    typedef std::function<MODEL* (long seed)> factory_type;
+  private:
+    std::vector<MODEL*> chains_;
+    ThreadPool pool_;
+
+    static size_t default_threads(const size_t n_chains) {
+      return std::max<size_t>(1, std::min<size_t>(n_chains, std::thread::hardware_concurrency()));
+    }
+
+    void init(const size_t n_chains, factory_type factory, const long seed) {
+      if(n_chains == 0) {
+        throw std::logic_error("ERROR: need at least one chain.");
+      }
+      for(size_t i = 0; i < n_chains; i++) {
+        chains_.push_back(make_chain<MODEL>(factory, seed, i));
+      }
+    }
+  public:
+    MCMultiChain(const size_t n_chains, const long seed = 42, const size_t n_threads = 0):
+      pool_(n_threads ? n_threads : default_threads(n_chains)) {
+      init(n_chains, [](long s) { return new MODEL(s); }, seed);
+    }
+
+    MCMultiChain(const size_t n_chains, factory_type factory, const long seed = 42, const size_t n_threads = 0):
+      pool_(n_threads ? n_threads : default_threads(n_chains)) {
+      init(n_chains, factory, seed);
+    }
+
+    ~MCMultiChain() {
+      for(auto c : chains_) {
+        delete c;
+      }
+    }
+
+    size_t size() const { return chains_.size(); }
+    MODEL& chain(const size_t i) { return *chains_.at(i); }
+
+    void sample(int iterations, int burn, int adapt, int thin) {
+      pool_.run(chains_.size(), [&](size_t i) { chains_[i]->sample(iterations, burn, adapt, thin); });
+    }
+
+    double acceptance_ratio() const {
+      double ans(0);
+      for(auto c : chains_) {
+        ans += c->acceptance_ratio();
+      }
+      return ans / chains_.size();
+    }
+
+    // all chains' draws of a member variable, in chain order
+    template<typename T>
+    History<T> history(T MODEL::* member) {
+      History<T> ans(chains_[0]->*member);
+      for(auto c : chains_) {
+        ans.append(c->getNode(c->*member).history);
+      }
+      return ans;
+    }
+
+    template<typename T>
+    T mean(T MODEL::* member) {
+      size_t n(0);
+      T ans;
+      for(auto c : chains_) {
+        for(const T& v : c->getNode(c->*member).history) {
+          if(n++ == 0) {
+            ans = v;
+          } else {
+            ans += v;
+          }
+        }
+      }
+      if(n == 0) {
+        return T();
+      }
+      ans /= static_cast<double>(n);
+      return ans;
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_MULTICHAIN_HPP
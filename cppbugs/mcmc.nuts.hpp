@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_NUTS_HPP
+#define MCMC_NUTS_HPP
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <armadillo>
+#include <cppbugs/mcmc.rng.base.hpp>
+
+namespace cppbugs {
+
+  // the no-u-turn sampler with dual averaging of the step size
+  // Hoffman and Gelman, JMLR 15 2014, algorithm 6
+  //
+  // target returns the logp at theta and stores its gradient in grad
+  class NUTS {
+  public:
+    typedef std::function<double (const arma::vec& theta, arma::vec& grad)> target_type;
+  private:
+    struct State {
+      arma::vec theta, r, grad;
+      double logp;
+      double joint() const { return logp - 0.5 * arma::dot(r, r); }
+    };
+
+    struct Tree {
+      State minus, plus, proposal;
+      double n;
+      bool s;
+      double alpha, n_alpha;
+    };
+
+    target_type target_;
+    RngBase& rng_;
+    State current_;
+    double eps_;
+    int max_depth_;
+
+    // dual averaging
+    double delta_, mu_, h_bar_, log_eps_bar_;
+    int m_;
+
+    void leapfrog(State& s, const double eps) {
+      s.r += 0.5 * eps * s.grad;
+      s.theta += eps * s.r;
+      s.logp = target_(s.theta, s.grad);
+      s.r += 0.5 * eps * s.grad;
+    }
+
+    static bool no_u_turn(const State& minus, const State& plus) {
+      const arma::vec d = plus.theta - minus.theta;
+      return arma::dot(d, minus.r) >= 0 && arma::dot(d, plus.r) >= 0;
+    }
+
+    Tree build(const State& edge, const double log_u, const int v, const int j, const double joint0) {
+      Tree t;
+      if(j == 0) {
+        State s(edge);
+        leapfrog(s, v * eps_);
+        const double joint = s.joint();
+        t.minus = t.plus = t.proposal = s;
+        t.n = log_u <= joint ? 1 : 0;
+        // also false when joint is nan
+        t.s = log_u < 1000 + joint;
+        t.alpha = std::isnan(joint) ? 0 : std::min(1.0, exp(joint - joint0));
+        t.n_alpha = 1;
+        return t;
+      }
+      t = build(edge, log_u, v, j - 1, joint0);
+      if(t.s) {
+        const Tree u = build(v == -1 ? t.minus : t.plus, log_u, v, j - 1, joint0);
+        if(v == -1) { t.minus = u.minus; } else { t.plus = u.plus; }
+        if(u.n > 0 && rng_.uniform() < u.n / (t.n + u.n)) {
+          t.proposal = u.proposal;
+        }
+        t.alpha += u.alpha;
+        t.n_alpha += u.n_alpha;
+        t.s = u.s && no_u_turn(t.minus, t.plus);
+        t.n += u.n;
+      }
+      return t;
+    }
+
+    void momentum(State& s) {
+      s.r.set_size(s.theta.n_elem);
+      for(size_t i = 0; i < s.r.n_elem; i++) { s.r[i] = rng_.normal(); }
+    }
+
+    // double or halve eps until the acceptance of one leapfrog step crosses 1/2
+    void initStepSize() {
+      eps_ = 1;
+      State s(current_);
+      momentum(s);
+      const double joint0 = s.joint();
+      State t(s);
+      leapfrog(t, eps_);
+      const double a = t.joint() - joint0 > log(0.5) ? 1 : -1;
+      for(int i = 0; i < 100 && a * (t.joint() - joint0) > -a * log(2.0); i++) {
+        eps_ *= std::pow(2.0, a);
+        t = s;
+        leapfrog(t, eps_);
+      }
+      mu_ = log(10 * eps_);
+      h_bar_ = 0;
+      log_eps_bar_ = 0;
+      m_ = 0;
+    }
+  public:
+    NUTS(target_type target, RngBase& rng, const double delta = 0.8, const int max_depth = 10):
+      target_(target), rng_(rng), eps_(1), max_depth_(max_depth), delta_(delta), mu_(0), h_bar_(0), log_eps_bar_(0), m_(0) {}
+
+    // start from theta, finding a first step size
+    void init(const arma::vec& theta) {
+      reset(theta);
+      if(std::isinf(current_.logp) || std::isnan(current_.logp)) {
+        throw std::logic_error("ERROR: hamiltonian sampling needs a starting point with finite logp.");
+      }
+      initStepSize();
+    }
+
+    // move to theta, ie after other samplers changed the target
+    void reset(const arma::vec& theta) {
+      current_.theta = theta;
+      current_.logp = target_(current_.theta, current_.grad);
+    }
+
+    // one transition, returns its mean acceptance statistic
+    double step() {
+      State s0(current_);
+      momentum(s0);
+      const double joint0 = s0.joint();
+      const double log_u = joint0 + log(rng_.uniform());
+      Tree t;
+      t.minus = t.plus = t.proposal = s0;
+      t.n = 1;
+      t.s = true;
+      double alpha(0), n_alpha(1);
+      for(int j = 0; t.s && j < max_depth_; j++) {
+        const int v = rng_.uniform() < 0.5 ? -1 : 1;
+        const Tree u = build(v == -1 ? t.minus : t.plus, log_u, v, j, joint0);
+        if(v == -1) { t.minus = u.minus; } else { t.plus = u.plus; }
+        if(u.s && rng_.uniform() < u.n / t.n) {
+          t.proposal = u.proposal;
+        }
+        t.n += u.n;
+        t.s = u.s && no_u_turn(t.minus, t.plus);
+        alpha = u.alpha;
+        n_alpha = u.n_alpha;
+      }
+      current_ = t.proposal;
+      return alpha / n_alpha;
+    }
+
+    // move eps toward a mean acceptance statistic of delta
+    void adapt(const double accept_stat) {
+      m_ += 1;
+      const double eta = 1.0 / (m_ + 10);
+      h_bar_ = (1 - eta) * h_bar_ + eta * (delta_ - accept_stat);
+      const double log_eps = mu_ - std::sqrt(static_cast<double>(m_)) / 0.05 * h_bar_;
+      const double w = std::pow(static_cast<double>(m_), -0.75);
+      log_eps_bar_ = w * log_eps + (1 - w) * log_eps_bar_;
+      eps_ = exp(log_eps);
+    }
+
+    // keep the averaged step size for sampling
+    void finishAdaptation() {
+      if(m_ > 0) { eps_ = exp(log_eps_bar_); }
+    }
+
+    const arma::vec& position() const { return current_.theta; }
+    double logp() const { return current_.logp; }
+    double getStepSize() const { return eps_; }
+    void setStepSize(const double eps) { eps_ = eps; }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_NUTS_HPP
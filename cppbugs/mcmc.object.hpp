@@ -18,6 +18,7 @@
 #ifndef MCMC_OBJECT_HPP
 #define MCMC_OBJECT_HPP
 
+#include <iosfwd>
 #include <cppbugs/mcmc.rng.base.hpp>
 
 namespace cppbugs {
@@ -30,15 +31,27 @@ namespace cppbugs {
     virtual void accept() = 0;
     virtual void reject() = 0;
     virtual void tune() = 0;
+    virtual void adapt() = 0;
     virtual void preserve() = 0;
+    virtual void setDoubleBuffered(const bool double_buffered) = 0;
     virtual void revert() = 0;
     virtual void tally() = 0;
+    // writes out buffered draws
+    virtual void flush() = 0;
+    // makes room in the history for more draws
+    virtual void reserve(const size_t draws) = 0;
     virtual bool isDeterministc() const = 0;
     virtual bool isStochastic() const = 0;
     virtual bool isObserved() const = 0;
     virtual void setScale(const double scale) = 0;
     virtual double getScale() const = 0;
     virtual double size() const = 0;
+    virtual const void* address() const = 0;
+    // swaps values with the same node of a replica of the model
+    virtual void exchange(MCMCObject& other) = 0;
+    // binary image of the sampler state of the node
+    virtual void write(std::ostream& out) const = 0;
+    virtual void read(std::istream& in) = 0;
   };
 
 } // namespace cppbugs
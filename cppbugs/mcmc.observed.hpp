@@ -33,15 +33,23 @@ namespace cppbugs {
     void accept() {}
     void reject() {}
     void tune() {}
+    void adapt() {}
     void preserve() {}
+    void setDoubleBuffered(const bool) {}
     void revert() {}
     void tally() {}
+    void flush() {}
+    void reserve(const size_t) {}
     bool isDeterministc() const { return false; }
     bool isStochastic() const { return true; }
     bool isObserved() const { return true; }
     void setScale(const double) {}
     double getScale() const { return 0; }
     double size() const { return 0; }
+    const void* address() const { return &value; }
+    void exchange(MCMCObject&) {}
+    void write(std::ostream&) const {}
+    void read(std::istream&) {}
   };
 
 } // namespace cppbugs
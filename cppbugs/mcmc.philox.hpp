@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_PHILOX_HPP
+#define MCMC_PHILOX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+namespace cppbugs {
+
+  // Philox4x32-10 (Salmon et al. 2011), a counter-based engine: output block
+  // i of stream s is a keyed bijection of the counter (i, s), so streams are
+  // independent and discard() costs nothing.  The key is the seed.
+  // Can be used wherever a std:: engine is, ie MCModel<Philox4x32>.
+  class Philox4x32 {
+  public:
+    typedef uint32_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xFFFFFFFF; }
+
+    explicit Philox4x32(const uint64_t seed = 0, const uint64_t stream = 0): key_(seed), stream_(stream), position_(0) {
+      refill();
+    }
+
+    void seed(const uint64_t seed) { key_ = seed; position_ = 0; refill(); }
+    void set_stream(const uint64_t stream) { stream_ = stream; position_ = 0; refill(); }
+    uint64_t stream() const { return stream_; }
+
+    result_type operator()() {
+      if((position_ & 3) == 0) {
+        block(position_ >> 2, buffer_);
+      }
+      return buffer_[position_++ & 3];
+    }
+
+    void discard(const unsigned long long n) {
+      position_ += n;
+      refill();
+    }
+
+    // n outputs at once, whole blocks are written in place
+    void fill(result_type* out, size_t n) {
+      for(; n && (position_ & 3); n--) {
+        *out++ = (*this)();
+      }
+      for(; n >= 4; n -= 4, out += 4, position_ += 4) {
+        block(position_ >> 2, out);
+      }
+      for(; n; n--) {
+        *out++ = (*this)();
+      }
+    }
+
+    // the 4 outputs of block i of the stream
+    void block(const uint64_t i, result_type* out) const {
+      uint32_t c0 = static_cast<uint32_t>(i), c1 = static_cast<uint32_t>(i >> 32);
+      uint32_t c2 = static_cast<uint32_t>(stream_), c3 = static_cast<uint32_t>(stream_ >> 32);
+      uint32_t k0 = static_cast<uint32_t>(key_), k1 = static_cast<uint32_t>(key_ >> 32);
+      for(int r = 0; r < 10; r++) {
+        const uint64_t p0 = static_cast<uint64_t>(0xD2511F53) * c0;
+        const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57) * c2;
+        c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        c1 = static_cast<uint32_t>(p1);
+        c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c3 = static_cast<uint32_t>(p0);
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+      out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    // checks block() against the Random123 known-answer vectors,
+    // counter c0..c3 and key k0 k1 giving the outputs
+    static bool self_test() {
+      static const uint32_t kat[3][10] = {
+        // c0..c3, k0, k1, outputs
+        {0, 0, 0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+        {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+         0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+        {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+         0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+      for(const uint32_t* v : kat) {
+        const Philox4x32 g(v[4] | static_cast<uint64_t>(v[5]) << 32, v[2] | static_cast<uint64_t>(v[3]) << 32);
+        result_type out[4];
+        g.block(v[0] | static_cast<uint64_t>(v[1]) << 32, out);
+        for(int j = 0; j < 4; j++) {
+          if(out[j] != v[6 + j]) { return false; }
+        }
+      }
+      return true;
+    }
+
+    friend bool operator==(const Philox4x32& a, const Philox4x32& b) {
+      return a.key_ == b.key_ && a.stream_ == b.stream_ && a.position_ == b.position_;
+    }
+    friend bool operator!=(const Philox4x32& a, const Philox4x32& b) { return !(a == b); }
+
+    friend std::ostream& operator<<(std::ostream& out, const Philox4x32& x) {
+      return out << x.key_ << ' ' << x.stream_ << ' ' << x.position_;
+    }
+    friend std::istream& operator>>(std::istream& in, Philox4x32& x) {
+      in >> x.key_ >> x.stream_ >> x.position_;
+      x.refill();
+      return in;
+    }
+  private:
+    uint64_t key_, stream_, position_;
+    result_type buffer_[4];
+
+    // the buffer holds the block of position_ unless it is at a block boundary
+    void refill() {
+      if(position_ & 3) {
+        block(position_ >> 2, buffer_);
+      }
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_PHILOX_HPP
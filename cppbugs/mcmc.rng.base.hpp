@@ -18,6 +18,7 @@
 #ifndef MCMC_RNG_BASE_HPP
 #define MCMC_RNG_BASE_HPP
 
+#include <cstddef>
 
 namespace cppbugs {
 
@@ -26,6 +27,17 @@ namespace cppbugs {
     RngBase() {}
     virtual double normal() = 0;
     virtual double uniform() = 0;
+    // n draws at once, engines override these with faster generators
+    virtual void normal(double* out, const size_t n) {
+      for(size_t i = 0; i < n; i++) { out[i] = normal(); }
+    }
+    virtual void uniform(double* out, const size_t n) {
+      for(size_t i = 0; i < n; i++) { out[i] = uniform(); }
+    }
+    template<typename T>
+    void fill_normal(T& x) { normal(x.memptr(), x.n_elem); }
+    template<typename T>
+    void fill_uniform(T& x) { uniform(x.memptr(), x.n_elem); }
     //virtual int poisson(n) = 0;
     // etc...
   };
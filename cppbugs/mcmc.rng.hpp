@@ -19,12 +19,17 @@
 #define MCMC_RNG_HPP
 
 #include <random>
+#include <sstream>
 #include <cppbugs/mcmc.rng.base.hpp>
+#include <cppbugs/mcmc.serialize.hpp>
+#include <cppbugs/mcmc.ziggurat.hpp>
+#include <cppbugs/mcmc.philox.hpp>
 
 namespace cppbugs {
 
+  // final, so calls through a SpecializedRng are not virtual
   template<typename T>
-  class SpecializedRng : public RngBase {
+  class SpecializedRng final : public RngBase {
   private:
     T generator_;
     std::uniform_real_distribution<double> uniform_rng_;
@@ -55,6 +60,48 @@ namespace cppbugs {
     }
 
     double uniform() { return uniform_rng_(generator_); }
+
+    // engines with streams, such as Philox4x32
+    void set_stream(const uint64_t stream) {
+      generator_.set_stream(stream);
+      next_norm_ = NAN;
+    }
+
+    void discard(const unsigned long long n) {
+      generator_.discard(n);
+      next_norm_ = NAN;
+    }
+
+    // n draws by the ziggurat, in place of the polar method of normal()
+    void normal(double* out, const size_t n) {
+      const Ziggurat& z = Ziggurat::tables();
+      auto u = [this]() { return uniform_rng_(generator_); };
+      for(size_t i = 0; i < n; i++) {
+        out[i] = z(u);
+      }
+    }
+
+    void uniform(double* out, const size_t n) {
+      for(size_t i = 0; i < n; i++) {
+        out[i] = uniform_rng_(generator_);
+      }
+    }
+
+    // the engine state goes through its stream operators
+    void write(std::ostream& out) const {
+      std::ostringstream state;
+      state << generator_ << ' ' << uniform_rng_;
+      write_binary(out, state.str());
+      write_binary(out, next_norm_);
+    }
+
+    void read(std::istream& in) {
+      std::string s;
+      read_binary(in, s);
+      std::istringstream state(s);
+      state >> generator_ >> uniform_rng_;
+      read_binary(in, next_norm_);
+    }
   };
 
 } // namespace cppbugs
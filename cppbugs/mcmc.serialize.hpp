@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_SERIALIZE_HPP
+#define MCMC_SERIALIZE_HPP
+
+#include <string>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <armadillo>
+
+namespace cppbugs {
+
+  // raw binary images, only meant to be read back on the same platform
+
+  template<typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  write_binary(std::ostream& out, const T x) {
+    out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+  }
+
+  template<typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  read_binary(std::istream& in, T& x) {
+    in.read(reinterpret_cast<char*>(&x), sizeof(T));
+    if(!in) {
+      throw std::logic_error("ERROR: unexpected end of binary input.");
+    }
+  }
+
+  inline void write_binary(std::ostream& out, const std::string& x) {
+    write_binary(out, static_cast<unsigned long long>(x.size()));
+    out.write(x.data(), x.size());
+  }
+
+  inline void read_binary(std::istream& in, std::string& x) {
+    unsigned long long n;
+    read_binary(in, n);
+    x.resize(n);
+    in.read(&x[0], n);
+    if(!in) {
+      throw std::logic_error("ERROR: unexpected end of binary input.");
+    }
+  }
+
+  template<typename eT>
+  void write_binary(std::ostream& out, const arma::Mat<eT>& x) {
+    write_binary(out, static_cast<unsigned long long>(x.n_rows));
+    write_binary(out, static_cast<unsigned long long>(x.n_cols));
+    out.write(reinterpret_cast<const char*>(x.memptr()), x.n_elem * sizeof(eT));
+  }
+
+  template<typename eT>
+  void read_binary(std::istream& in, arma::Mat<eT>& x) {
+    unsigned long long n_rows, n_cols;
+    read_binary(in, n_rows);
+    read_binary(in, n_cols);
+    x.set_size(n_rows, n_cols);
+    in.read(reinterpret_cast<char*>(x.memptr()), x.n_elem * sizeof(eT));
+    if(!in) {
+      throw std::logic_error("ERROR: unexpected end of binary input.");
+    }
+  }
+
+} // namespace cppbugs
+#endif // MCMC_SERIALIZE_HPP
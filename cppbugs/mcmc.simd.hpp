@@ -0,0 +1,312 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_SIMD_HPP
+#define MCMC_SIMD_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CPPBUGS_SIMD_X86 1
+#define CPPBUGS_SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define CPPBUGS_SIMD_INLINE inline
+#endif
+
+// the kernels are evaluated exactly as written, so that every lane type
+// gives the same results
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace cppbugs {
+  namespace simd {
+
+    // double precision log, exp, log1p and lgamma without branches, written
+    // once against a lane type: plain doubles, or 4 (AVX2) or 8 (AVX-512) doubles
+    // log and log1p give -inf below their domain, lgamma +inf for x <= 0,
+    // like log_approx the results are meant for log densities
+
+    // lanes are only passed by reference and results written through the first
+    // argument, as gcc warns about the ABI of vectors passed or returned by value
+    // (even by inlined functions) when the translation unit is not built for them
+
+    // adding 1.5 * 2^52 moves an integer valued double into the low bits
+    const double round_shift = 6755399441055744.0;
+    const int64_t round_shift_bits = 0x4338000000000000LL;
+
+    struct scalar_lane {
+      typedef double V;
+      typedef int64_t I;
+      static CPPBUGS_SIMD_INLINE void splat(V& out, const double x) { out = x; }
+      static CPPBUGS_SIMD_INLINE void as_double(V& out, const I& x) { std::memcpy(&out, &x, sizeof(V)); }
+      static CPPBUGS_SIMD_INLINE void as_bits(I& out, const V& x) { std::memcpy(&out, &x, sizeof(I)); }
+      // to the nearest integer, -ffast-math would fold away the shift
+      static CPPBUGS_SIMD_INLINE void round(V& out, const V& x) {
+#ifdef __FAST_MATH__
+        out = std::nearbyint(x);
+#else
+        out = (x + round_shift) - round_shift;
+#endif
+      }
+    };
+
+#ifdef CPPBUGS_SIMD_X86
+    template<int N>
+    struct vector_lane {
+      typedef double V __attribute__((vector_size(8 * N)));
+      typedef int64_t I __attribute__((vector_size(8 * N)));
+      static CPPBUGS_SIMD_INLINE void splat(V& out, const double x) { out = V{} + x; }
+      static CPPBUGS_SIMD_INLINE void as_double(V& out, const I& x) { out = (V)x; }
+      static CPPBUGS_SIMD_INLINE void as_bits(I& out, const V& x) { out = (I)x; }
+      static CPPBUGS_SIMD_INLINE void round(V& out, const V& x) {
+#ifdef __FAST_MATH__
+        double a[N];
+        std::memcpy(a, &x, sizeof(a));
+        for(int i = 0; i < N; i++) { a[i] = __builtin_nearbyint(a[i]); }
+        std::memcpy(&out, a, sizeof(a));
+#else
+        out = (x + round_shift) - round_shift;
+#endif
+      }
+    };
+#endif
+
+    // ans must not be x
+    template<typename L>
+    CPPBUGS_SIMD_INLINE void log_kernel(typename L::V& ans, const typename L::V& x) {
+      typedef typename L::V V;
+      typedef typename L::I I;
+      V inf, ninf;
+      L::splat(inf, std::numeric_limits<double>::infinity());
+      L::splat(ninf, -std::numeric_limits<double>::infinity());
+
+      // x = m * 2^e, sqrt(1/2) <= m < sqrt(2), subnormals scaled up first
+      const auto subnormal = x < 2.2250738585072014e-308;
+      const V y = subnormal ? x * 18014398509481984.0 : x;
+      I bits;
+      L::as_bits(bits, y);
+      I e = ((bits >> 52) & 0x7ff) - 1023;
+      e = subnormal ? e - 54 : e;
+      V m;
+      L::as_double(m, (bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+      const auto high = m > 1.4142135623730951;
+      m = high ? m * 0.5 : m;
+      e = high ? e + 1 : e;
+
+      // log(m) = 2 atanh(r)
+      const V r = (m - 1.0) / (m + 1.0);
+      const V r2 = r * r;
+      V p;
+      L::splat(p, 2.0/21);
+      p = p * r2 + 2.0/19;
+      p = p * r2 + 2.0/17;
+      p = p * r2 + 2.0/15;
+      p = p * r2 + 2.0/13;
+      p = p * r2 + 2.0/11;
+      p = p * r2 + 2.0/9;
+      p = p * r2 + 2.0/7;
+      p = p * r2 + 2.0/5;
+      p = p * r2 + 2.0/3;
+      p = p * r2 + 2.0;
+
+      V fe;
+      L::as_double(fe, e + round_shift_bits);
+      fe = fe - round_shift;
+      const V a = fe * 6.93147180369123816490e-01 + (r * p + fe * 1.90821492927058770002e-10);
+      ans = x > 0.0 ? (x == inf ? inf : a) : (x == x ? ninf : x);
+    }
+
+    template<typename L>
+    CPPBUGS_SIMD_INLINE void exp_kernel(typename L::V& ans, const typename L::V& x) {
+      typedef typename L::V V;
+      typedef typename L::I I;
+      V hi, lo, inf, zero;
+      L::splat(hi, 710.0);
+      L::splat(lo, -746.0);
+      L::splat(inf, std::numeric_limits<double>::infinity());
+      L::splat(zero, 0.0);
+
+      // x = k log(2) + r, |r| <= log(2)/2
+      V xc = x > 710.0 ? hi : x;
+      xc = xc < -746.0 ? lo : xc;
+      V k;
+      L::round(k, xc * 1.4426950408889634);
+      const V r = (xc - k * 6.93147180369123816490e-01) - k * 1.90821492927058770002e-10;
+
+      V p;
+      L::splat(p, 1.0/479001600);
+      p = p * r + 1.0/39916800;
+      p = p * r + 1.0/3628800;
+      p = p * r + 1.0/362880;
+      p = p * r + 1.0/40320;
+      p = p * r + 1.0/5040;
+      p = p * r + 1.0/720;
+      p = p * r + 1.0/120;
+      p = p * r + 1.0/24;
+      p = p * r + 1.0/6;
+      p = p * r + 0.5;
+      p = p * r + 1.0;
+      p = p * r + 1.0;
+
+      // 2^k in two halves, so that subnormal results are reached
+      I n;
+      L::as_bits(n, k + round_shift);
+      n = n - round_shift_bits;
+      const I n1 = n >> 1;
+      const I n2 = n - n1;
+      V s1, s2;
+      L::as_double(s1, (n1 + 1023) << 52);
+      L::as_double(s2, (n2 + 1023) << 52);
+      V a = p * s1 * s2;
+      a = x > 709.782712893384 ? inf : a;
+      ans = x < -745.1332191019412 ? zero : (x == x ? a : x);
+    }
+
+    template<typename L>
+    CPPBUGS_SIMD_INLINE void log1p_kernel(typename L::V& ans, const typename L::V& x) {
+      typedef typename L::V V;
+      const V u = x + 1.0;
+      V lu;
+      log_kernel<L>(lu, u);
+      // corrects for the rounding of 1 + x
+      const V a = u > 0.0 ? lu - ((u - 1.0) - x) / u : lu;
+      ans = x == std::numeric_limits<double>::infinity() ? x : a;
+    }
+
+    template<typename L>
+    CPPBUGS_SIMD_INLINE void lgamma_kernel(typename L::V& ans, const typename L::V& x) {
+      typedef typename L::V V;
+      V inf, one;
+      L::splat(inf, std::numeric_limits<double>::infinity());
+      L::splat(one, 1.0);
+
+      // lgamma(x) = lgamma(x + 8) - log(x (x + 1) ... (x + 7)) below 8, then Stirling's series
+      const auto small = x < 8.0;
+      const V shifted = x * (x + 1.0) * (x + 2.0) * (x + 3.0) *
+        (x + 4.0) * (x + 5.0) * (x + 6.0) * (x + 7.0);
+      const V prod = small ? shifted : one;
+      const V z = small ? x + 8.0 : x;
+      const V w = 1.0 / z;
+      const V w2 = w * w;
+      V s;
+      L::splat(s, 1.0/156);
+      s = s * w2 + -691.0/360360;
+      s = s * w2 + 1.0/1188;
+      s = s * w2 + -1.0/1680;
+      s = s * w2 + 1.0/1260;
+      s = s * w2 + -1.0/360;
+      s = s * w2 + 1.0/12;
+
+      V log_z, log_prod;
+      log_kernel<L>(log_z, z);
+      log_kernel<L>(log_prod, prod);
+      const V a = (z - 0.5) * log_z - z + 0.91893853320467274178 + s * w - log_prod;
+      ans = x > 0.0 ? (x == inf ? inf : a) : (x == x ? inf : x);
+    }
+
+    struct log_op { template<typename L> static CPPBUGS_SIMD_INLINE void eval(typename L::V& ans, const typename L::V& x) { log_kernel<L>(ans, x); } };
+    struct exp_op { template<typename L> static CPPBUGS_SIMD_INLINE void eval(typename L::V& ans, const typename L::V& x) { exp_kernel<L>(ans, x); } };
+    struct log1p_op { template<typename L> static CPPBUGS_SIMD_INLINE void eval(typename L::V& ans, const typename L::V& x) { log1p_kernel<L>(ans, x); } };
+    struct lgamma_op { template<typename L> static CPPBUGS_SIMD_INLINE void eval(typename L::V& ans, const typename L::V& x) { lgamma_kernel<L>(ans, x); } };
+
+    inline double log(const double x) { double ans; log_kernel<scalar_lane>(ans, x); return ans; }
+    inline double exp(const double x) { double ans; exp_kernel<scalar_lane>(ans, x); return ans; }
+    inline double log1p(const double x) { double ans; log1p_kernel<scalar_lane>(ans, x); return ans; }
+    inline double lgamma(const double x) { double ans; lgamma_kernel<scalar_lane>(ans, x); return ans; }
+
+    // bulk versions, out may be x
+    typedef void (*bulk_function)(const double*, double*, size_t);
+
+    template<typename Op>
+    void bulk_scalar(const double* x, double* out, const size_t n) {
+      for(size_t i = 0; i < n; i++) {
+        const double v = x[i];
+        Op::template eval<scalar_lane>(out[i], v);
+      }
+    }
+
+#ifdef CPPBUGS_SIMD_X86
+    template<typename Op, int N>
+    CPPBUGS_SIMD_INLINE void bulk_vector(const double* x, double* out, const size_t n) {
+      typedef vector_lane<N> L;
+      size_t i = 0;
+      for(; i + N <= n; i += N) {
+        typename L::V v, ans;
+        std::memcpy(&v, x + i, sizeof(v));
+        Op::template eval<L>(ans, v);
+        std::memcpy(out + i, &ans, sizeof(ans));
+      }
+      for(; i < n; i++) {
+        const double v = x[i];
+        Op::template eval<scalar_lane>(out[i], v);
+      }
+    }
+
+    template<typename Op>
+    __attribute__((target("avx2"))) void bulk_avx2(const double* x, double* out, const size_t n) {
+      bulk_vector<Op, 4>(x, out, n);
+    }
+
+    template<typename Op>
+    __attribute__((target("avx512f,avx512dq"))) void bulk_avx512(const double* x, double* out, const size_t n) {
+      bulk_vector<Op, 8>(x, out, n);
+    }
+#endif
+
+    // the widest kernel the cpu runs
+    template<typename Op>
+    bulk_function select_bulk() {
+#ifdef CPPBUGS_SIMD_X86
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return bulk_avx512<Op>;
+      }
+      if(__builtin_cpu_supports("avx2")) {
+        return bulk_avx2<Op>;
+      }
+#endif
+      return bulk_scalar<Op>;
+    }
+
+    template<typename Op>
+    void bulk(const double* x, double* out, const size_t n) {
+      static const bulk_function f = select_bulk<Op>();
+      f(x, out, n);
+    }
+
+    inline void log(const double* x, double* out, const size_t n) { bulk<log_op>(x, out, n); }
+    inline void exp(const double* x, double* out, const size_t n) { bulk<exp_op>(x, out, n); }
+    inline void log1p(const double* x, double* out, const size_t n) { bulk<log1p_op>(x, out, n); }
+    inline void lgamma(const double* x, double* out, const size_t n) { bulk<lgamma_op>(x, out, n); }
+
+  } // namespace simd
+} // namespace cppbugs
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT DEFAULT
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif // MCMC_SIMD_HPP
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_SLICE_HPP
+#define MCMC_SLICE_HPP
+
+#include <cmath>
+#include <cppbugs/mcmc.rng.base.hpp>
+
+namespace cppbugs {
+
+  enum class StepMethod { metropolis, slice };
+
+  // univariate slice sampling by stepping out and shrinkage
+  // Neal, Annals of Statistics 31(3) 2003, figures 3 and 5
+  //
+  // logp(v) sets x to v and returns the log density, logp0 is its value at the
+  // current x; the last call is always made at the returned draw
+  template<typename F>
+  double slice_step(RngBase& rng, double& x, const double w, const double logp0, F logp, const int max_steps = 32) {
+    const double x0 = x;
+    const double y = logp0 + log(rng.uniform());
+
+    double left = x0 - w * rng.uniform();
+    double right = left + w;
+    int j = static_cast<int>(max_steps * rng.uniform());
+    int k = max_steps - 1 - j;
+    for(; j > 0 && y < logp(left); j--) { left -= w; }
+    for(; k > 0 && y < logp(right); k--) { right += w; }
+
+    for(int i = 0; i < 100; i++) {
+      const double x1 = left + rng.uniform() * (right - left);
+      const double logp1 = logp(x1);
+      if(y < logp1) {
+        return logp1;
+      }
+      if(x1 < x0) { left = x1; } else { right = x1; }
+    }
+    // only reached if logp is nan around x0
+    return logp(x0);
+  }
+
+} // namespace cppbugs
+#endif // MCMC_SLICE_HPP
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_STATIC_MODEL_HPP
+#define MCMC_STATIC_MODEL_HPP
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <stdexcept>
+#include <algorithm>
+#include <cppbugs/mcmc.model.hpp>
+
+namespace cppbugs {
+
+  template<size_t I = 0, typename F, typename... T>
+  inline typename std::enable_if<(I == sizeof...(T))>::type for_each_node(std::tuple<T...>&, const F&) {}
+
+  template<size_t I = 0, typename F, typename... T>
+  inline typename std::enable_if<(I < sizeof...(T))>::type for_each_node(std::tuple<T...>& nodes, const F& f) {
+    f(std::get<I>(nodes));
+    for_each_node<I + 1>(nodes, f);
+  }
+
+  // a model whose nodes and likelihoods are tuples of concrete types, with
+  // the update of the deterministic nodes as a template parameter: every call
+  // of step() is resolved at compile time, so the sweep inlines into one function
+  // metropolis steps only (no gibbs, slice, blocks, tempering or likelihood threads)
+  template<class RNG, class UPDATE, class NODES, class LIKELIHOODS>
+  class StaticModel;
+
+  template<class RNG, class UPDATE, typename... NODES, typename... LIKELIHOODS>
+  class StaticModel<RNG, UPDATE, std::tuple<NODES...>, std::tuple<LIKELIHOODS...> > {
+  public:
+    typedef RNG rng_type;
+    typedef std::tuple<NODES...> nodes_type;
+    typedef std::tuple<LIKELIHOODS...> likelihoods_type;
+  private:
+    SpecializedRng<RNG> rng_;
+    UPDATE update_;
+    nodes_type nodes_;
+    likelihoods_type likelihoods_;
+    double accepted_, rejected_, logp_value_;
+
+    // qualified calls, so the likelihoods are not called through their vtable
+    template<size_t I>
+    typename std::enable_if<(I == sizeof...(LIKELIHOODS)), double>::type sum_logp(const double ans) const { return ans; }
+
+    template<size_t I>
+    typename std::enable_if<(I < sizeof...(LIKELIHOODS)), double>::type sum_logp(const double ans) const {
+      typedef typename std::tuple_element<I, likelihoods_type>::type L;
+      return sum_logp<I + 1>(ans + std::get<I>(likelihoods_).L::calc());
+    }
+
+    static bool bad_logp(const double value) { return std::isnan(value) || value == -std::numeric_limits<double>::infinity(); }
+
+    bool reject(const double value, const double old_logp) {
+      return bad_logp(value) || log(rng_.uniform()) > value - old_logp;
+    }
+
+    // deterministic nodes are only recomputed by update
+    template<typename N>
+    void metropolis(N&, std::false_type) {}
+
+    template<typename N>
+    void metropolis(N& node, std::true_type) {
+      const double old_logp_value = logp_value_;
+      node.N::preserve();
+      node.jump_with(rng_);
+      logp_value_ = logp();
+      if(reject(logp_value_, old_logp_value)) {
+        node.N::revert();
+        update_();
+        logp_value_ = old_logp_value;
+        node.N::reject();
+        rejected_ += 1;
+      } else {
+        node.N::accept();
+        accepted_ += 1;
+      }
+    }
+
+    struct step_node {
+      StaticModel& m;
+      template<typename N>
+      void operator()(N& node) const {
+        m.metropolis(node, std::integral_constant<bool, has_jump_with<N, SpecializedRng<RNG> >::value>());
+      }
+    };
+    struct adapt_node { template<typename N> void operator()(N& node) const { node.N::adapt(); } };
+    struct tune_node { template<typename N> void operator()(N& node) const { node.N::tune(); } };
+    struct tally_node { template<typename N> void operator()(N& node) const { node.N::tally(); } };
+    struct flush_node { template<typename N> void operator()(N& node) const { node.N::flush(); } };
+    struct reserve_node {
+      size_t draws;
+      template<typename N> void operator()(N& node) const { node.N::reserve(draws); }
+    };
+  public:
+    // the nodes are constructed from values, a std::tie of the variables they track
+    template<typename... VALUES>
+    StaticModel(UPDATE update, const std::tuple<VALUES&...>& values, const likelihoods_type& likelihoods, long seed = 42):
+      rng_(seed), update_(update), nodes_(values), likelihoods_(likelihoods),
+      accepted_(0), rejected_(0), logp_value_(-std::numeric_limits<double>::infinity()) {}
+
+    double logp() {
+      update_();
+      return sum_logp<0>(0);
+    }
+
+    void step() { for_each_node(nodes_, step_node{*this}); }
+
+    void sample(int iterations, int burn, int adapt, int thin) {
+      if(iterations % thin) {
+        throw std::logic_error("ERROR: iterations not a multiple of thin.");
+      }
+      logp_value_ = logp();
+      if(logp_value_ == -std::numeric_limits<double>::infinity()) {
+        throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+      }
+
+      // tuning phase
+      const int tuning_step = std::max(adapt / 100, 1);
+      for(int i = 1; i <= adapt; i++) {
+        step();
+        for_each_node(nodes_, adapt_node());
+        if(i % tuning_step == 0) {
+          for_each_node(nodes_, tune_node());
+        }
+      }
+      // there is no joint move whose scale MCModel::tune_global would tune, this
+      // second pass only lengthens the adaptation of the nodes
+      for(int i = 1; i <= adapt; i++) {
+        step();
+        for_each_node(nodes_, adapt_node());
+      }
+      resetAcceptanceRatio();
+
+      // sampling
+      for_each_node(nodes_, reserve_node{static_cast<size_t>(iterations / thin)});
+      for(int i = 1; i <= iterations + burn; i++) {
+        step();
+        if(i > burn && (i - burn) % thin == 0) {
+          for_each_node(nodes_, tally_node());
+        }
+      }
+      for_each_node(nodes_, flush_node());
+    }
+
+    double acceptance_ratio() const {
+      return accepted_ / (accepted_ + rejected_);
+    }
+
+    void resetAcceptanceRatio() {
+      accepted_ = 0;
+      rejected_ = 0;
+    }
+
+    nodes_type& nodes() { return nodes_; }
+
+    template<size_t I>
+    typename std::tuple_element<I, nodes_type>::type& node() { return std::get<I>(nodes_); }
+
+    SpecializedRng<RNG>& rng() { return rng_; }
+  };
+
+  // the nodes cannot be copied, so the model is returned on the heap
+  template<class RNG, class NODES, class UPDATE, typename... VALUES, typename... LIKELIHOODS>
+  std::unique_ptr<StaticModel<RNG, UPDATE, NODES, std::tuple<LIKELIHOODS...> > >
+  make_static_model(UPDATE update, const std::tuple<VALUES&...>& values, const std::tuple<LIKELIHOODS...>& likelihoods, long seed = 42) {
+    return std::unique_ptr<StaticModel<RNG, UPDATE, NODES, std::tuple<LIKELIHOODS...> > >(
+      new StaticModel<RNG, UPDATE, NODES, std::tuple<LIKELIHOODS...> >(update, values, likelihoods, seed));
+  }
+
+} // namespace cppbugs
+#endif // MCMC_STATIC_MODEL_HPP
@@ -20,20 +20,48 @@
 
 #include <limits>
 #include <cmath>
+#include <vector>
+#include <type_traits>
+#include <cppbugs/mcmc.math.hpp>
 
 namespace cppbugs {
 
+  class Adjoints;
+
   class Likelihiood {
+    std::vector<const void*> arguments_;
+  protected:
+    // record an argument read by calc()
+    // arguments held by value or by const reference are constants, anything
+    // else (ie the value of another node) may change between calls
+    // an expression held by value is recorded as null: it may depend on any node
+    template<typename A>
+    void argument(const typename std::remove_reference<A>::type& arg) {
+      if(std::is_reference<A>::value && !std::is_const<typename std::remove_reference<A>::type>::value) {
+        arguments_.push_back(&arg);
+      } else if(!std::is_reference<A>::value && is_arma_expression<A>::value) {
+        arguments_.push_back(nullptr);
+      }
+    }
   public:
     virtual ~Likelihiood() {}
     virtual double calc() const = 0;
+    // upper bound of calc() over all values of the nodes
+    virtual double upper_bound() const { return std::numeric_limits<double>::infinity(); }
+    // number of elements calc_chunk can split calc() into, 0 if it cannot
+    virtual size_t elements() const { return 0; }
+    // the terms of calc() for the elements [first, last) of x
+    virtual double calc_chunk(const size_t /*first*/, const size_t /*last*/) const { return calc(); }
+    // add the derivatives of calc() to adj, false if not available
+    virtual bool gradient(Adjoints&) const { return false; }
+    const std::vector<const void*>& arguments() const { return arguments_; }
   };
 
   class Stochastic {
   protected:
     Likelihiood* likelihood_functor;
   public:
-    Stochastic() {}
+    Stochastic(): likelihood_functor(nullptr) {}
     ~Stochastic() { delete likelihood_functor; }
     double loglik() const {
       return 
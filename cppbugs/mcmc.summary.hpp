@@ -0,0 +1,246 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_SUMMARY_HPP
+#define MCMC_SUMMARY_HPP
+
+#include <vector>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <armadillo>
+#include <cppbugs/mcmc.serialize.hpp>
+#include <cppbugs/mcmc.trace.hpp>
+
+namespace cppbugs {
+
+  // P^2 streaming estimate of a quantile, Jain and Chlamtac (1985)
+  class P2Quantile {
+    double p_, q_[5], n_[5], np_[5], dn_[5];
+    size_t count_;
+
+    double parabolic(const int i, const double s) const {
+      return q_[i] + s / (n_[i+1] - n_[i-1]) *
+        ((n_[i] - n_[i-1] + s) * (q_[i+1] - q_[i]) / (n_[i+1] - n_[i]) +
+         (n_[i+1] - n_[i] - s) * (q_[i] - q_[i-1]) / (n_[i] - n_[i-1]));
+    }
+    double linear(const int i, const int s) const {
+      return q_[i] + s * (q_[i+s] - q_[i]) / (n_[i+s] - n_[i]);
+    }
+  public:
+    P2Quantile(const double p): p_(p), count_(0) {
+      const double np[5] = {0, 2*p, 4*p, 2 + 2*p, 4};
+      const double dn[5] = {0, p/2, p, (1 + p)/2, 1};
+      for(int i = 0; i < 5; i++) {
+        n_[i] = i;
+        np_[i] = np[i];
+        dn_[i] = dn[i];
+      }
+    }
+
+    void add(const double x) {
+      if(count_ < 5) {
+        q_[count_++] = x;
+        if(count_ == 5) { std::sort(q_, q_ + 5); }
+        return;
+      }
+      int k;
+      if(x < q_[0]) {
+        q_[0] = x;
+        k = 0;
+      } else if(x >= q_[4]) {
+        q_[4] = x;
+        k = 3;
+      } else {
+        k = 0;
+        while(x >= q_[k+1]) { ++k; }
+      }
+      for(int i = k + 1; i < 5; i++) { n_[i] += 1; }
+      for(int i = 0; i < 5; i++) { np_[i] += dn_[i]; }
+      ++count_;
+
+      for(int i = 1; i < 4; i++) {
+        const double d = np_[i] - n_[i];
+        if((d >= 1 && n_[i+1] - n_[i] > 1) || (d <= -1 && n_[i-1] - n_[i] < -1)) {
+          const int s = d > 0 ? 1 : -1;
+          const double q = parabolic(i, s);
+          q_[i] = (q_[i-1] < q && q < q_[i+1]) ? q : linear(i, s);
+          n_[i] += s;
+        }
+      }
+    }
+
+    double value() const {
+      if(count_ >= 5) {
+        return q_[2];
+      }
+      if(count_ == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+      }
+      std::vector<double> x(q_, q_ + count_);
+      std::sort(x.begin(), x.end());
+      return x[static_cast<size_t>(std::floor(p_ * (count_ - 1) + 0.5))];
+    }
+
+    void write(std::ostream& out) const {
+      write_binary(out, p_);
+      write_binary(out, static_cast<unsigned long long>(count_));
+      for(int i = 0; i < 5; i++) {
+        write_binary(out, q_[i]);
+        write_binary(out, n_[i]);
+        write_binary(out, np_[i]);
+        write_binary(out, dn_[i]);
+      }
+    }
+
+    void read(std::istream& in) {
+      unsigned long long count;
+      read_binary(in, p_);
+      read_binary(in, count);
+      count_ = count;
+      for(int i = 0; i < 5; i++) {
+        read_binary(in, q_[i]);
+        read_binary(in, n_[i]);
+        read_binary(in, np_[i]);
+        read_binary(in, dn_[i]);
+      }
+    }
+  };
+
+  // element-wise running mean and variance (Welford), extremes and quantiles of the draws of a node
+  class Summary {
+    std::vector<double> probs_;
+    size_t count_;
+    arma::vec mean_, m2_, min_, max_;
+    std::vector<P2Quantile> quantiles_;   // element major
+
+    size_t quantileIndex(const double p) const {
+      for(size_t k = 0; k < probs_.size(); k++) {
+        if(probs_[k] == p) { return k; }
+      }
+      throw std::logic_error("ERROR: quantile not tracked by the summary.");
+    }
+
+    // sized by the first draw, as a node may be sized after it is tracked
+    void init(const size_t n_elem) {
+      mean_.set_size(n_elem);
+      m2_.set_size(n_elem);
+      min_.set_size(n_elem);
+      max_.set_size(n_elem);
+      mean_.fill(0);
+      m2_.fill(0);
+      min_.fill(std::numeric_limits<double>::infinity());
+      max_.fill(-std::numeric_limits<double>::infinity());
+      quantiles_.clear();
+      quantiles_.reserve(n_elem * probs_.size());
+      for(size_t j = 0; j < n_elem; j++) {
+        for(double p : probs_) {
+          quantiles_.push_back(P2Quantile(p));
+        }
+      }
+    }
+  public:
+    Summary(const std::vector<double>& probs): probs_(probs), count_(0) {
+      for(double p : probs) {
+        if(p < 0 || p > 1) {
+          throw std::logic_error("ERROR: quantile probabilities must be in [0,1].");
+        }
+      }
+    }
+
+    template<typename T>
+    void add(const T& x) {
+      if(count_ == 0) {
+        init(trace_size(x));
+      } else if(trace_size(x) != mean_.n_elem) {
+        throw std::logic_error("ERROR: the size of a node changed between draws.");
+      }
+      ++count_;
+      const size_t n_q = probs_.size();
+      for(size_t j = 0; j < mean_.n_elem; j++) {
+        const double v = trace_element(x, j);
+        const double delta = v - mean_[j];
+        mean_[j] += delta / count_;
+        m2_[j] += delta * (v - mean_[j]);
+        min_[j] = std::min(min_[j], v);
+        max_[j] = std::max(max_[j], v);
+        for(size_t k = 0; k < n_q; k++) {
+          quantiles_[j * n_q + k].add(v);
+        }
+      }
+    }
+
+    size_t count() const { return count_; }
+    const std::vector<double>& probs() const { return probs_; }
+    const arma::vec& mean() const { return mean_; }
+    const arma::vec& min() const { return min_; }
+    const arma::vec& max() const { return max_; }
+    arma::vec var() const {
+      arma::vec ans(m2_.n_elem);
+      for(size_t j = 0; j < ans.n_elem; j++) {
+        ans[j] = count_ > 1 ? m2_[j] / (count_ - 1) : 0;
+      }
+      return ans;
+    }
+    arma::vec sd() const {
+      arma::vec ans(var());
+      for(size_t j = 0; j < ans.n_elem; j++) { ans[j] = std::sqrt(ans[j]); }
+      return ans;
+    }
+    // p must be one of the probabilities given to setSummary
+    arma::vec quantile(const double p) const {
+      const size_t k = quantileIndex(p), n_q = probs_.size();
+      arma::vec ans(mean_.n_elem);
+      for(size_t j = 0; j < ans.n_elem; j++) {
+        ans[j] = quantiles_[j * n_q + k].value();
+      }
+      return ans;
+    }
+
+    void write(std::ostream& out) const {
+      write_binary(out, static_cast<unsigned long long>(probs_.size()));
+      for(double p : probs_) { write_binary(out, p); }
+      write_binary(out, static_cast<unsigned long long>(count_));
+      write_binary(out, mean_);
+      write_binary(out, m2_);
+      write_binary(out, min_);
+      write_binary(out, max_);
+      for(const P2Quantile& q : quantiles_) { q.write(out); }
+    }
+
+    // restores the probabilities along with the state
+    void read(std::istream& in) {
+      unsigned long long n_probs, count;
+      read_binary(in, n_probs);
+      probs_.resize(n_probs);
+      for(double& p : probs_) { read_binary(in, p); }
+      read_binary(in, count);
+      count_ = count;
+      read_binary(in, mean_);
+      read_binary(in, m2_);
+      read_binary(in, min_);
+      read_binary(in, max_);
+      quantiles_.assign(count_ ? mean_.n_elem * probs_.size() : 0, P2Quantile(0));
+      for(P2Quantile& q : quantiles_) { q.read(in); }
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_SUMMARY_HPP
@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_TEMPERING_HPP
+#define MCMC_TEMPERING_HPP
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cppbugs/mcmc.math.hpp>
+#include <cppbugs/mcmc.rng.hpp>
+#include <cppbugs/mcmc.thread.pool.hpp>
+#include <cppbugs/mcmc.multichain.hpp>
+
+namespace cppbugs {
+
+  // parallel tempering: replicas of a model sample the posterior to the power
+  // 1/T for a ladder of temperatures T, and adjacent replicas swap their
+  // states every few iterations.  only the draws of the replica at T = 1 are
+  // kept.  MODEL is built as for MCMultiChain.
+  //
+  // the ladder starts with temperatures doubling, and its spacing is adapted
+  // during the tuning phases toward a swap acceptance of 0.234
+  // Miasojedow, Moulines and Vihola, J. Comp. Graph. Stat. 22(3) 2013
+  template<class MODEL>
+  class MCTempering {
+  public:
+    typedef std::function<MODEL* (long seed)> factory_type;
+  private:
+    std::vector<MODEL*> replicas_;
+    ThreadPool pool_;
+    SpecializedRng<std::mt19937> rng_;
+    int swap_interval_;
+    // log of the log ratio of adjacent temperatures
+    std::vector<double> rho_;
+    std::vector<double> swaps_, accepted_swaps_;
+    double rounds_;
+
+    static size_t default_threads(const size_t n_replicas) {
+      return std::max<size_t>(1, std::min<size_t>(n_replicas, std::thread::hardware_concurrency()));
+    }
+
+    void init(const size_t n_replicas, factory_type factory, const long seed) {
+      if(n_replicas == 0) {
+        throw std::logic_error("ERROR: need at least one replica.");
+      }
+      for(size_t i = 0; i < n_replicas; i++) {
+        replicas_.push_back(make_chain<MODEL>(factory, seed, i));
+      }
+      rho_.assign(n_replicas - 1, log(log(2.0)));
+      resetSwapAcceptance();
+      setLadder();
+    }
+
+    void setLadder() {
+      double t(1);
+      replicas_[0]->setTemperature(t);
+      for(size_t k = 0; k < rho_.size(); k++) {
+        t *= exp(exp(rho_[k]));
+        replicas_[k + 1]->setTemperature(t);
+      }
+    }
+
+    // proposes to swap each pair of adjacent replicas in turn
+    void swap(const bool adapt) {
+      std::vector<double> logp(replicas_.size());
+      for(size_t k = 0; k < replicas_.size(); k++) {
+        logp[k] = replicas_[k]->logp();
+      }
+      rounds_ += 1;
+      for(size_t k = 0; k + 1 < replicas_.size(); k++) {
+        MODEL& cold = *replicas_[k];
+        MODEL& hot = *replicas_[k + 1];
+        const double delta = (1 / cold.getTemperature() - 1 / hot.getTemperature()) * (logp[k + 1] - logp[k]);
+        const bool accept = log(rng_.uniform()) < delta;
+        if(accept) {
+          cold.exchange(hot);
+          std::swap(logp[k], logp[k + 1]);
+        }
+        swaps_[k] += 1;
+        accepted_swaps_[k] += accept;
+        if(adapt) {
+          rho_[k] += ((accept ? 1 : 0) - 0.234) / std::pow(rounds_, 0.6);
+        }
+      }
+      if(adapt) {
+        setLadder();
+      }
+    }
+
+    // f(replica, iterations) on every replica, then swaps, in rounds of swap_interval_
+    void rounds(const int iterations, const bool adapt, std::function<void (size_t, int, int)> f) {
+      for(int i = 0; i < iterations; i += swap_interval_) {
+        const int n = std::min(swap_interval_, iterations - i);
+        pool_.run(replicas_.size(), [&](size_t k) { f(k, i, n); });
+        swap(adapt);
+      }
+    }
+  public:
+    MCTempering(const size_t n_replicas, const long seed = 42, const size_t n_threads = 0):
+      pool_(n_threads ? n_threads : default_threads(n_replicas)), rng_(chain_seed(seed, n_replicas)),
+      swap_interval_(10), rounds_(0) {
+      init(n_replicas, [](long s) { return new MODEL(s); }, seed);
+    }
+
+    MCTempering(const size_t n_replicas, factory_type factory, const long seed = 42, const size_t n_threads = 0):
+      pool_(n_threads ? n_threads : default_threads(n_replicas)), rng_(chain_seed(seed, n_replicas)),
+      swap_interval_(10), rounds_(0) {
+      init(n_replicas, factory, seed);
+    }
+
+    ~MCTempering() {
+      for(auto r : replicas_) {
+        delete r;
+      }
+    }
+
+    size_t size() const { return replicas_.size(); }
+    MODEL& replica(const size_t i) { return *replicas_.at(i); }
+    // the replica at temperature 1
+    MODEL& cold() { return *replicas_[0]; }
+
+    double temperature(const size_t i) const { return replicas_.at(i)->getTemperature(); }
+
+    // acceptance of the swaps between replicas i and i+1 while sampling, nan before any swap
+    double swap_acceptance_ratio(const size_t i) const {
+      return swaps_.at(i) ? accepted_swaps_[i] / swaps_[i] : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    void resetSwapAcceptance() {
+      swaps_.assign(rho_.size(), 0);
+      accepted_swaps_.assign(rho_.size(), 0);
+    }
+
+    // iterations between swap proposals
+    void setSwapInterval(const int swap_interval) {
+      if(swap_interval < 1) {
+        throw std::logic_error("ERROR: swap interval must be positive.");
+      }
+      swap_interval_ = swap_interval;
+    }
+
+    // same phases as MCModel::sample, with swaps
+    void sample(int iterations, int burn, int adapt, int thin) {
+      if(iterations % thin) {
+        throw std::logic_error("ERROR: iterations not a multiple of thin.");
+      }
+
+      pool_.run(replicas_.size(), [&](size_t k) {
+          replicas_[k]->initChain();
+          if(replicas_[k]->logp() == -std::numeric_limits<double>::infinity()) {
+            throw std::logic_error("ERROR: cannot start from a logp of -Inf.");
+          }
+        });
+
+      // tuning phase, the ladder adapts along with the scales, which are tuned
+      // every adapt/100 iterations as in MCModel::sample
+      const int tuning_step = std::max(adapt / 100, 1);
+      rounds(adapt, true, [&](size_t k, int i, int n) { replicas_[k]->tune(n, tuning_step, i); });
+      rounds(adapt, true, [&](size_t k, int i, int n) { replicas_[k]->tune_global(n, tuning_step, i); });
+      resetSwapAcceptance();
+
+      // sampling, run(0, ...) only computes the starting logp
+      pool_.run(replicas_.size(), [&](size_t k) { replicas_[k]->run(0, 0, thin); });
+      cold().reserve(iterations / thin);
+      rounds(iterations + burn, false, [&](size_t k, int i, int n) {
+          for(int j = i + 1; j <= i + n; j++) {
+            replicas_[k]->step();
+            if(k == 0 && j > burn && (j % thin == 0)) {
+              replicas_[k]->tally();
+            }
+          }
+        });
+      cold().flush();
+    }
+
+    double acceptance_ratio() const {
+      return replicas_[0]->acceptance_ratio();
+    }
+
+    // draws of a member variable at temperature 1
+    template<typename T>
+    const History<T>& history(T MODEL::* member) {
+      return cold().getNode(cold().*member).history;
+    }
+
+    template<typename T>
+    T mean(T MODEL::* member) {
+      return cold().getNode(cold().*member).mean();
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_TEMPERING_HPP
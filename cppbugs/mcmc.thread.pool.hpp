@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_THREAD_POOL_HPP
+#define MCMC_THREAD_POOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+namespace cppbugs {
+
+  // persistent set of worker threads
+  // run(n, f) calls f(0) ... f(n-1) across the workers and the calling thread
+  // and blocks until all calls have returned.  the first exception thrown by
+  // any task is rethrown in the calling thread.
+  class ThreadPool {
+  private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_, done_cv_;
+    std::function<void (size_t)> task_;
+    size_t n_tasks_, next_, done_;
+    bool stop_;
+    std::exception_ptr error_;
+
+    // pull task indices until none are left, lock must be held on entry and is held on exit
+    void work(std::unique_lock<std::mutex>& lock) {
+      while(next_ < n_tasks_) {
+        const size_t i = next_++;
+        lock.unlock();
+        try {
+          task_(i);
+        } catch(...) {
+          lock.lock();
+          if(!error_) { error_ = std::current_exception(); }
+          lock.unlock();
+        }
+        lock.lock();
+        if(++done_ == n_tasks_) { done_cv_.notify_all(); }
+      }
+    }
+
+    void worker() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for(;;) {
+        work_cv_.wait(lock, [this]() { return stop_ || next_ < n_tasks_; });
+        if(stop_) { return; }
+        work(lock);
+      }
+    }
+  public:
+    ThreadPool(size_t n_threads = std::thread::hardware_concurrency()):
+      n_tasks_(0), next_(0), done_(0), stop_(false) {
+      // the calling thread also does work in run()
+      for(size_t i = 1; i < n_threads; i++) {
+        workers_.push_back(std::thread(&ThreadPool::worker, this));
+      }
+    }
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      work_cv_.notify_all();
+      for(auto& t : workers_) { t.join(); }
+    }
+
+    size_t size() const { return workers_.size() + 1; }
+
+    void run(const size_t n, std::function<void (size_t)> f) {
+      if(n == 0) { return; }
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_ = f;
+      n_tasks_ = n;
+      next_ = 0;
+      done_ = 0;
+      error_ = nullptr;
+      work_cv_.notify_all();
+      work(lock);
+      done_cv_.wait(lock, [this]() { return done_ == n_tasks_; });
+      n_tasks_ = 0;
+      next_ = 0;
+      if(error_) { std::rethrow_exception(error_); }
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_THREAD_POOL_HPP
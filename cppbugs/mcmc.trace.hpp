@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_TRACE_HPP
+#define MCMC_TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <armadillo>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cppbugs/mcmc.serialize.hpp>
+
+namespace cppbugs {
+
+  // trace file layout, all fields 8 bytes so that the samples are aligned:
+  //   header: "CBTRACE1", number of elements of the node
+  //   chunks: number of draws n, then the n x elements matrix of draws in column major order
+  // a file is appended to chunk by chunk, a truncated last chunk is ignored by the reader
+
+  static const char trace_magic[8] = {'C','B','T','R','A','C','E','1'};
+
+  inline double trace_element(const double x, const size_t) { return x; }
+  inline double trace_element(const int x, const size_t) { return x; }
+  inline double trace_element(const bool x, const size_t) { return x; }
+  template<typename eT>
+  double trace_element(const arma::Mat<eT>& x, const size_t j) { return x[j]; }
+
+  inline size_t trace_size(const double) { return 1; }
+  inline size_t trace_size(const int) { return 1; }
+  inline size_t trace_size(const bool) { return 1; }
+  template<typename eT>
+  size_t trace_size(const arma::Mat<eT>& x) { return x.n_elem; }
+
+  // the header is written with the first draw, as a node may be sized after it is tracked
+  class TraceWriter {
+    const std::string path_;
+    std::ofstream out_;
+    size_t n_elem_, chunk_rows_;
+    std::vector<double> buffer_;
+    size_t rows_, file_rows_;
+
+    void open(const std::ios::openmode mode) {
+      out_.open(path_.c_str(), std::ios::binary | mode);
+      if(!out_) {
+        throw std::logic_error("ERROR: cannot open trace " + path_ + ".");
+      }
+    }
+
+    // walks the chunks of the file, stopping after max_rows draws
+    // returns the offset of the end of the last complete chunk, 0 without a header
+    std::streamoff scan(const size_t max_rows, size_t& rows, size_t& n_elem) const {
+      std::ifstream in(path_.c_str(), std::ios::binary);
+      char magic[8];
+      unsigned long long n, chunk_rows;
+      rows = 0;
+      if(!in.read(magic, 8)) {
+        return 0;
+      }
+      read_binary(in, n);
+      if(std::memcmp(magic, trace_magic, 8)) {
+        throw std::logic_error("ERROR: " + path_ + " is not a trace.");
+      }
+      n_elem = n;
+      in.seekg(0, std::ios::end);
+      const std::streamoff size = in.tellg();
+      std::streamoff pos = 16;
+      while(rows < max_rows && pos + 8 <= size) {
+        in.seekg(pos);
+        read_binary(in, chunk_rows);
+        const std::streamoff next = pos + 8 + chunk_rows * n * sizeof(double);
+        if(next > size) {
+          break;
+        }
+        rows += chunk_rows;
+        pos = next;
+      }
+      return pos;
+    }
+
+    void start(const size_t n_elem) {
+      size_t rows, n_file(n_elem);
+      const bool header = scan(std::numeric_limits<size_t>::max(), rows, n_file) > 0;
+      if(n_file != n_elem) {
+        throw std::logic_error("ERROR: " + path_ + " is not a trace of this node.");
+      }
+      if(!header) {
+        out_.write(trace_magic, 8);
+        write_binary(out_, static_cast<unsigned long long>(n_elem));
+      }
+      n_elem_ = n_elem;
+      chunk_rows_ = chunk_rows_ ? chunk_rows_ : std::max<size_t>(1, (1 << 20) / std::max<size_t>(n_elem, 1));
+      buffer_.resize(chunk_rows_ * n_elem_);
+      file_rows_ = rows;
+    }
+  public:
+    // chunk_rows of 0 picks about 8MB per chunk
+    TraceWriter(const std::string& path, const size_t chunk_rows = 0):
+      path_(path), n_elem_(0), chunk_rows_(chunk_rows), rows_(0), file_rows_(0) {
+      open(std::ios::app);
+    }
+    // errors are dropped here, call close() to see them
+    ~TraceWriter() {
+      try { flush(); } catch(const std::exception&) {}
+    }
+
+    template<typename T>
+    void add(const T& x) {
+      if(buffer_.empty()) {
+        start(trace_size(x));
+      } else if(trace_size(x) != n_elem_) {
+        throw std::logic_error("ERROR: the size of a node changed between draws.");
+      }
+      for(size_t j = 0; j < n_elem_; j++) {
+        buffer_[j * chunk_rows_ + rows_] = trace_element(x, j);
+      }
+      if(++rows_ == chunk_rows_) {
+        flush();
+      }
+    }
+
+    void flush() {
+      if(rows_ == 0) {
+        return;
+      }
+      write_binary(out_, static_cast<unsigned long long>(rows_));
+      for(size_t j = 0; j < n_elem_; j++) {
+        out_.write(reinterpret_cast<const char*>(&buffer_[j * chunk_rows_]), rows_ * sizeof(double));
+      }
+      out_.flush();
+      file_rows_ += rows_;
+      rows_ = 0;
+      if(!out_) {
+        throw std::logic_error("ERROR: cannot write trace " + path_ + ".");
+      }
+    }
+
+    void close() {
+      flush();
+      out_.close();
+      if(!out_) {
+        throw std::logic_error("ERROR: cannot write trace " + path_ + ".");
+      }
+    }
+
+    // draws in the file and in the buffer
+    size_t rows() const { return file_rows_ + rows_; }
+
+    // drops the draws after the first rows, e.g. those written again on resume
+    void truncate(const size_t rows) {
+      flush();
+      out_.close();
+      size_t found, n_elem(0);
+      const std::streamoff end = scan(rows, found, n_elem);
+      if(found != rows || ::truncate(path_.c_str(), end)) {
+        throw std::logic_error("ERROR: cannot truncate trace " + path_ + ".");
+      }
+      open(std::ios::app);
+      if(!buffer_.empty()) { file_rows_ = rows; }
+    }
+  };
+
+  // maps a trace file, each chunk is a draws x elements matrix using the mapped memory
+  class TraceReader {
+    void* data_;
+    size_t bytes_, n_elem_, n_draws_;
+    std::vector<std::unique_ptr<const arma::mat> > chunks_;
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+  public:
+    TraceReader(const std::string& path): data_(MAP_FAILED), bytes_(0), n_elem_(0), n_draws_(0) {
+      const int fd = open(path.c_str(), O_RDONLY);
+      struct stat st;
+      if(fd < 0 || fstat(fd, &st) < 0) {
+        if(fd >= 0) { close(fd); }
+        throw std::logic_error("ERROR: cannot open trace " + path + ".");
+      }
+      bytes_ = st.st_size;
+      if(bytes_ >= 16) {
+        data_ = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+      }
+      close(fd);
+      if(data_ == MAP_FAILED || std::memcmp(data_, trace_magic, 8)) {
+        if(data_ != MAP_FAILED) { munmap(data_, bytes_); }
+        throw std::logic_error("ERROR: " + path + " is not a trace.");
+      }
+
+      const unsigned long long* p = static_cast<const unsigned long long*>(data_);
+      const size_t n_words = bytes_ / 8;
+      n_elem_ = p[1];
+      size_t pos = 2;
+      while(pos < n_words && p[pos] <= (n_words - pos - 1) / std::max<size_t>(n_elem_, 1)) {
+        const size_t rows = p[pos];
+        double* x = const_cast<double*>(reinterpret_cast<const double*>(p + pos + 1));
+        chunks_.emplace_back(new arma::mat(x, rows, n_elem_, false, true));
+        n_draws_ += rows;
+        pos += 1 + rows * n_elem_;
+      }
+    }
+    ~TraceReader() { munmap(data_, bytes_); }
+
+    size_t n_elem() const { return n_elem_; }
+    size_t n_draws() const { return n_draws_; }
+    size_t n_chunks() const { return chunks_.size(); }
+    const arma::mat& chunk(const size_t i) const { return *chunks_[i]; }
+
+    // copies the draws of element j out of all the chunks
+    arma::vec element(const size_t j) const {
+      arma::vec ans(n_draws_);
+      size_t i = 0;
+      for(auto& c : chunks_) {
+        std::memcpy(ans.memptr() + i, c->colptr(j), c->n_rows * sizeof(double));
+        i += c->n_rows;
+      }
+      return ans;
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_TRACE_HPP
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2011 Whit Armstrong                                     //
+//                                                                       //
+// This program is free software: you can redistribute it and/or modify  //
+// it under the terms of the GNU General Public License as published by  //
+// the Free Software Foundation, either version 3 of the License, or     //
+// (at your option) any later version.                                   //
+//                                                                       //
+// This program is distributed in the hope that it will be useful,       //
+// but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+// GNU General Public License for more details.                          //
+//                                                                       //
+// You should have received a copy of the GNU General Public License     //
+// along with this program.  If not, see <http://www.gnu.org/licenses/>. //
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MCMC_ZIGGURAT_HPP
+#define MCMC_ZIGGURAT_HPP
+
+#include <cmath>
+#include <cstdint>
+
+namespace cppbugs {
+
+  // Marsaglia and Tsang's ziggurat for the standard normal, 128 layers as in
+  // Doornik (2005): most draws take one uniform and a comparison, the
+  // wedges and the tail, about 1% of the draws, take exp or log
+  class Ziggurat {
+    static const int layers = 128;
+    double x_[layers + 1], ratio_[layers];
+
+    template<typename U>
+    double tail(U& uniform, const bool negative) const {
+      double x, y;
+      do {
+        x = std::log(1 - uniform()) / x_[1];
+        y = std::log(1 - uniform());
+      } while(-2 * y < x * x);
+      return negative ? x - x_[1] : x_[1] - x;
+    }
+  public:
+    Ziggurat() {
+      const double r = 3.442619855899, v = 9.91256303526217e-3;
+      double f = std::exp(-0.5 * r * r);
+      x_[0] = v / f;
+      x_[1] = r;
+      x_[layers] = 0;
+      for(int i = 2; i < layers; i++) {
+        x_[i] = std::sqrt(-2 * std::log(v / x_[i - 1] + f));
+        f = std::exp(-0.5 * x_[i] * x_[i]);
+      }
+      for(int i = 0; i < layers; i++) {
+        ratio_[i] = x_[i + 1] / x_[i];
+      }
+    }
+
+    // built once and shared read-only
+    static const Ziggurat& tables() {
+      static const Ziggurat z;
+      return z;
+    }
+
+    // uniform() returns doubles in [0,1) with 53 random bits, the low 7 pick
+    // the layer and the others the position in it
+    template<typename U>
+    double operator()(U& uniform) const {
+      for(;;) {
+        const uint64_t bits = static_cast<uint64_t>(uniform() * 9007199254740992.0);
+        const int i = bits & 0x7F;
+        const double u = (bits >> 7) * (1.0 / 35184372088832.0) - 1;
+        if(std::fabs(u) < ratio_[i]) {
+          return u * x_[i];
+        }
+        if(i == 0) {
+          return tail(uniform, u < 0);
+        }
+        const double x = u * x_[i];
+        const double f0 = std::exp(-0.5 * (x_[i] * x_[i] - x * x));
+        const double f1 = std::exp(-0.5 * (x_[i + 1] * x_[i + 1] - x * x));
+        if(f1 + uniform() * (f0 - f1) < 1.0) {
+          return x;
+        }
+      }
+    }
+  };
+
+} // namespace cppbugs
+#endif // MCMC_ZIGGURAT_HPP